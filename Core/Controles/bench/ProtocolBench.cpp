@@ -0,0 +1,718 @@
+// Host-native microbenchmarks for common/ControlProtocol.h.
+//
+//   pio run -e native && .pio/build/native/program [iterations]
+//
+// Prints one JSON document on stdout with ns/frame and frames/sec for each
+// protocol primitive. Before timing anything it cross-checks that every CRC
+// engine and cipher path agrees with its reference, that the airtime model
+// matches reference values, and that GET /status.bin documents round-trip,
+// then runs behaviour checks on the RX-side filters and the push channel
+// parsers. It exits non-zero if one fails, so the numbers are always for
+// byte-identical output.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../common/Airtime.h"
+#include "../common/ControlProtocol.h"
+#include "../common/HttpResponse.h"
+#include "../common/ServerSentEvents.h"
+#include "../common/StatusBinary.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using namespace TankControl;
+
+volatile uint32_t gSink = 0;
+
+struct Result {
+  const char *name;
+  size_t bytes;
+  uint64_t iterations;
+  double nsPerFrame;
+};
+
+std::vector<Result> gResults;
+
+template <typename Fn>
+void run(const char *name, size_t bytes, uint64_t iterations, Fn fn) {
+  for (uint64_t i = 0; i < iterations / 10 + 1; ++i) {
+    fn(i);
+  }
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < iterations; ++i) {
+    fn(i);
+  }
+  double elapsed =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  gResults.push_back({name, bytes, iterations, elapsed / iterations});
+}
+
+bool checkCrcEngines(std::mt19937 &rng) {
+  const uint8_t kCheck[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  if (crc32Bitwise(kCheck, sizeof(kCheck)) != 0xCBF43926u) {
+    return false;
+  }
+  uint8_t buffer[512];
+  for (uint8_t &b : buffer) {
+    b = static_cast<uint8_t>(rng());
+  }
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t length = 0; length + offset <= sizeof(buffer); ++length) {
+      uint32_t expected = crc32Bitwise(buffer + offset, length);
+      if (crc32Slice4(buffer + offset, length) != expected ||
+          crc32Slice8(buffer + offset, length) != expected ||
+          crc32(buffer + offset, length) != expected) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool checkCipherPaths(CipherSession &session) {
+  ControlFrame frame;
+  initFrame(frame, Command::Forward, 200, 180, 0x01020304);
+
+  uint8_t oneShot[kFrameSize];
+  uint8_t viaSession[kFrameSize];
+  if (!encryptFrame(frame, oneShot, sizeof(oneShot)) ||
+      !session.encrypt(frame, viaSession, sizeof(viaSession)) ||
+      memcmp(oneShot, viaSession, kFrameSize) != 0) {
+    return false;
+  }
+
+  ControlFrame decoded;
+  if (!decryptFrame(oneShot, sizeof(oneShot), decoded) ||
+      memcmp(&decoded, &frame, sizeof(frame)) != 0) {
+    return false;
+  }
+  if (!session.decodeAny(viaSession, sizeof(viaSession), decoded) ||
+      memcmp(&decoded, &frame, sizeof(frame)) != 0) {
+    return false;
+  }
+
+  uint8_t sealed[kAeadFrameSize];
+  uint16_t txTimeMs = 0;
+  uint8_t vehicle = 0;
+  if (session.sealV2(frame, 3, 0xBEEF, sealed, sizeof(sealed)) !=
+          kAeadFrameSize ||
+      !session.decodeAny(sealed, sizeof(sealed), decoded, &txTimeMs,
+                         &vehicle) ||
+      decoded.command != frame.command || decoded.sequence != frame.sequence ||
+      txTimeMs != 0xBEEF || vehicle != 3 ||
+      peekVehicle(sealed, sizeof(sealed)) != 3) {
+    return false;
+  }
+  // The address is authenticated: retargeting a frame must break the tag.
+  sealed[AeadHeaderSchema::offset<kAeadVehicleField>()] = 4;
+  if (session.openV2(sealed, sizeof(sealed), decoded)) {
+    return false;
+  }
+  sealed[AeadHeaderSchema::offset<kAeadVehicleField>()] = 3;
+  sealed[kAeadHeaderSize] ^= 0x01;
+  if (session.openV2(sealed, sizeof(sealed), decoded)) {
+    return false;
+  }
+
+  AckTelemetry ack = {frame.sequence, 3, -97, -30, -127, 100,
+                      kAckStatusTrajectoryActive};
+  AckTelemetry ackDecoded;
+  uint8_t ackFrame[kAckFrameSize];
+  if (session.sealAck(ack, ackFrame, sizeof(ackFrame)) != kAckFrameSize ||
+      !session.openAck(ackFrame, sizeof(ackFrame), ackDecoded) ||
+      ackDecoded.sequence != ack.sequence ||
+      ackDecoded.vehicle != ack.vehicle ||
+      ackDecoded.rssiDbm != ack.rssiDbm ||
+      ackDecoded.snrQuarterDb != ack.snrQuarterDb ||
+      ackDecoded.leftMotor != ack.leftMotor ||
+      ackDecoded.rightMotor != ack.rightMotor ||
+      ackDecoded.status != ack.status) {
+    return false;
+  }
+  ackFrame[kAckHeaderSize] ^= 0x01;
+  if (session.openAck(ackFrame, sizeof(ackFrame), ackDecoded)) {
+    return false;
+  }
+
+  // The RX restores the sequence across a 16-bit wrap from its reference.
+  uint8_t heartbeat[kHeartbeatFrameSize];
+  uint32_t heartbeatSequence = 0;
+  uint16_t periodMs = 0;
+  if (session.sealHeartbeat(0x0002FFFF + 2, 995, heartbeat,
+                            sizeof(heartbeat)) != kHeartbeatFrameSize ||
+      !session.openHeartbeat(heartbeat, sizeof(heartbeat), 0x0002FFFF,
+                             heartbeatSequence, periodMs) ||
+      heartbeatSequence != 0x00030001 || periodMs != 1000) {
+    return false;
+  }
+  heartbeat[kHeartbeatHeaderSize] ^= 0x01;
+  if (session.openHeartbeat(heartbeat, sizeof(heartbeat), 0x0002FFFF,
+                            heartbeatSequence, periodMs)) {
+    return false;
+  }
+
+  ControlFrameView view = session.openInPlace(oneShot, sizeof(oneShot));
+  return view.valid() && view.get<kSequenceField>() == frame.sequence;
+}
+
+// Reference values from the Semtech LoRa airtime calculator (CR 4/5,
+// 8-symbol preamble, explicit header, CRC on).
+bool checkAirtimeModel() {
+  struct Case {
+    uint8_t sf;
+    uint32_t bandwidthHz;
+    size_t length;
+    uint32_t airUs;
+  };
+  const Case kCases[] = {
+      {7, 125000, 8, 36096},    {7, 125000, 12, 41216},
+      {7, 125000, 16, 51456},
+      {7, 125000, 64, 118016},  {7, 500000, 16, 12864},
+      {10, 125000, 16, 329728}, {12, 125000, 16, 1318912},
+  };
+  for (const Case &c : kCases) {
+    RadioProfile profile = kDefaultRadioProfile;
+    profile.spreadingFactor = c.sf;
+    profile.bandwidthHz = c.bandwidthHz;
+    if (timeOnAirUs(profile, c.length) != c.airUs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Worst case for one vehicle: a full trajectory.
+size_t writeStatusBinary(uint8_t *data, size_t capacity) {
+  StatusBinaryWriter writer(data, capacity);
+  bool ok = writer.begin(42, 1500) &&
+            writer.addVehicle(1, Command::Trajectory, 0, 0, 0, 7);
+  for (size_t i = 0; ok && i < kMaxTrajectorySegments; ++i) {
+    ok = writer.addSegment(Command::Forward, static_cast<uint8_t>(60 + i),
+                           static_cast<uint16_t>(500 + 100 * i));
+  }
+  return ok ? writer.length() : 0;
+}
+
+// Walks a GET /status.bin document the way the controller does.
+uint32_t readStatusBinary(const uint8_t *data, size_t length) {
+  StatusBinaryReader reader;
+  if (!reader.begin(data, length)) {
+    return 0;
+  }
+  uint32_t sum = reader.version();
+  while (reader.next()) {
+    const StatusBinaryVehicle &vehicle = reader.vehicle();
+    sum += vehicle.get<kStatusCommandField>() +
+           vehicle.get<kStatusTrajectoryIdField>();
+    for (uint8_t i = 0; i < vehicle.get<kStatusSegmentCountField>(); ++i) {
+      sum += reader.segment(i).get<kStatusSegmentDurationField>();
+    }
+  }
+  return sum;
+}
+
+// Round trip through the writer, and every truncation or extension of
+// the document is rejected.
+bool checkStatusBinary() {
+  uint8_t data[statusBinaryCapacity(1) + 1];
+  size_t length = writeStatusBinary(data, sizeof(data));
+  if (length != statusBinaryCapacity(1)) {
+    return false;
+  }
+  uint32_t expected = 42 + static_cast<uint32_t>(Command::Trajectory) + 7;
+  for (size_t i = 0; i < kMaxTrajectorySegments; ++i) {
+    expected += static_cast<uint32_t>(500 + 100 * i);
+  }
+  if (readStatusBinary(data, length) != expected) {
+    return false;
+  }
+  StatusBinaryReader reader;
+  for (size_t cut = 0; cut <= length + 1; ++cut) {
+    if (cut != length && reader.begin(data, cut)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// In-window reordering, duplicates, the 64-frame limit, a TX reboot into
+// a new epoch and the 32-bit wrap.
+bool checkReplayWindow() {
+  const uint32_t base = firstSequence(5) + 100;
+  ReplayWindow window;
+  if (!window.accept(base) || !window.accept(base + 3) ||
+      !window.accept(base + 1) || window.accept(base + 1) ||
+      window.accept(base + 3) || window.accept(base) ||
+      !window.accept(base + 2)) {
+    return false;
+  }
+  if (!window.accept(base + 200) || window.accept(base + 200 - 64) ||
+      !window.accept(base + 200 - 63) || window.check(base + 3)) {
+    return false;
+  }
+
+  // The TX reboots after a long run; its next epoch starts over at 0.
+  if (!window.accept(firstSequence(5) + 40000) ||
+      !window.accept(firstSequence(6)) || window.epoch() != 6 ||
+      window.accept(firstSequence(6)) ||
+      window.accept(firstSequence(5) + 40001) ||
+      !window.accept(firstSequence(6) + 2) ||
+      !window.accept(firstSequence(6) + 1)) {
+    return false;
+  }
+  // Frames from the end of the old epoch that fall inside the new window
+  // are still rejected.
+  window.reset();
+  if (!window.accept(firstSequence(7) - 2) ||
+      !window.accept(firstSequence(7)) ||
+      window.accept(firstSequence(7) - 1)) {
+    return false;
+  }
+
+  window.reset();
+  return window.accept(0xFFFFFFFEu) && window.accept(0xFFFFFFFFu) &&
+         window.accept(0) && !window.accept(0xFFFFFFFFu) &&
+         !window.accept(0xFFFFFFFDu) && window.accept(2) && window.accept(1) &&
+         !window.accept(1);
+}
+
+// Two vehicles acknowledging the same sequence with the same telemetry
+// must not produce the same keystream, and an ACK cannot be passed off as
+// another vehicle's.
+bool checkAckPerVehicle(CipherSession &session) {
+  AckTelemetry ack = {firstSequence(9) + 7, 1, -90, 12, 40, 40, 0};
+  uint8_t first[kAckFrameSize];
+  uint8_t second[kAckFrameSize];
+  if (session.sealAck(ack, first, sizeof(first)) != kAckFrameSize) {
+    return false;
+  }
+  ack.vehicle = 2;
+  if (session.sealAck(ack, second, sizeof(second)) != kAckFrameSize ||
+      memcmp(first + kAckHeaderSize, second + kAckHeaderSize,
+             kAckPayloadSize) == 0) {
+    return false;
+  }
+  AckTelemetry decoded;
+  if (!session.openAck(second, sizeof(second), decoded) ||
+      decoded.vehicle != 2) {
+    return false;
+  }
+  first[AckHeaderSchema::offset<kAckVehicleField>()] = 2;
+  return !session.openAck(first, sizeof(first), decoded);
+}
+
+// v2 trajectories round-trip at their exact length, are authenticated
+// down to the address, and never repeat ciphertext for repeated segments.
+bool checkTrajectoryV2(CipherSession &session) {
+  TrajectorySegment segments[kMaxTrajectorySegments];
+  for (size_t i = 0; i < kMaxTrajectorySegments; ++i) {
+    segments[i] = {static_cast<uint8_t>(Command::Forward), 180,
+                   static_cast<uint8_t>(i), 250};
+  }
+  TrajectoryPacket packet;
+  TrajectoryPacket decoded;
+  uint8_t sealed[kAeadTrajectoryMaxFrameSize];
+  uint16_t txTimeMs = 0;
+  const size_t length = aeadTrajectoryFrameSize(3);
+  if (!initTrajectory(packet, segments, 3, firstSequence(5), 2) ||
+      session.sealTrajectoryV2(packet, 0x1234, sealed, sizeof(sealed)) !=
+          length ||
+      peekVehicle(sealed, length) != 2 ||
+      !session.openTrajectoryV2(sealed, length, decoded, &txTimeMs) ||
+      decoded.header.leftSpeed != 3 ||
+      decoded.header.sequence != firstSequence(5) || decoded.vehicle != 2 ||
+      txTimeMs != 0x1234 ||
+      memcmp(decoded.segments, packet.segments, sizeof(packet.segments)) !=
+          0) {
+    return false;
+  }
+  // The next sequence with the same segments must not show on air.
+  uint8_t again[kAeadTrajectoryMaxFrameSize];
+  TrajectoryPacket next;
+  initTrajectory(next, segments, 3, firstSequence(5) + 1, 2);
+  if (session.sealTrajectoryV2(next, 0x1234, again, sizeof(again)) != length ||
+      memcmp(again + kAeadHeaderSize, sealed + kAeadHeaderSize,
+             length - kAeadHeaderSize - kAeadTagSize) == 0) {
+    return false;
+  }
+  sealed[AeadHeaderSchema::offset<kAeadVehicleField>()] = 3;
+  if (session.openTrajectoryV2(sealed, length, decoded)) {
+    return false;
+  }
+  sealed[AeadHeaderSchema::offset<kAeadVehicleField>()] = 2;
+  sealed[kAeadHeaderSize + 1] ^= 0x01;
+  if (session.openTrajectoryV2(sealed, length, decoded) ||
+      session.openTrajectoryV2(sealed, length - 1, decoded)) {
+    return false;
+  }
+  initTrajectory(packet, segments, kMaxTrajectorySegments, 7);
+  return session.sealTrajectoryV2(packet, 0, sealed, sizeof(sealed)) ==
+             kAeadTrajectoryMaxFrameSize &&
+         session.openTrajectoryV2(sealed, sizeof(sealed), decoded) &&
+         decoded.header.leftSpeed == kMaxTrajectorySegments &&
+         memcmp(decoded.segments, packet.segments, sizeof(packet.segments)) ==
+             0;
+}
+
+// A run of delayed frames stays dropped; only a new TX epoch, whose clock
+// restarted, re-anchors the offset estimate, and a frame late enough for
+// its age to wrap cannot drag it.
+bool checkStalenessFilter() {
+  StalenessFilter filter(500);
+  if (!filter.accept(3, 1000, 50000) || !filter.accept(3, 1100, 50100)) {
+    return false;
+  }
+  for (uint16_t i = 0; i < 5; ++i) {
+    uint16_t txTimeMs = static_cast<uint16_t>(1200 + 10 * i);
+    if (filter.accept(3, txTimeMs, 50900u + 10 * i) ||
+        filter.lastAgeMs() != 700) {
+      return false;
+    }
+  }
+  if (filter.dropped() != 5 || !filter.accept(3, 1950, 51050) ||
+      filter.offsetMs() != 49000) {
+    return false;
+  }
+  // Faster than any delivery so far: the estimate moves down.
+  if (!filter.accept(3, 2200, 51150) || filter.offsetMs() != 48950) {
+    return false;
+  }
+
+  // The TX reboots: new epoch, clock back near zero.
+  if (!filter.accept(4, 5, 52000) || filter.offsetMs() != 51995 ||
+      filter.lastAgeMs() != 0 || filter.accept(4, 105, 52700)) {
+    return false;
+  }
+  // Across the 16-bit clock wrap, after the 10 s relaxation step.
+  uint32_t rxNowMs = 140000;
+  if (!filter.accept(4, static_cast<uint16_t>(rxNowMs - 51995), rxNowMs) ||
+      !filter.accept(4, static_cast<uint16_t>(rxNowMs + 100 - 51995 - 400),
+                     rxNowMs + 100) ||
+      filter.accept(4, static_cast<uint16_t>(rxNowMs + 200 - 51995 - 600),
+                    rxNowMs + 200) ||
+      filter.dropped() != 7) {
+    return false;
+  }
+  // A frame held back 40 s wraps to a negative age. It is dropped and
+  // leaves the estimate alone (bar the relaxation step), so fresh frames
+  // still get through.
+  rxNowMs += 40300;
+  return !filter.accept(4, static_cast<uint16_t>(rxNowMs - 40000 - 51995),
+                        rxNowMs) &&
+         filter.offsetMs() == 51996 && filter.dropped() == 8 &&
+         filter.accept(4, static_cast<uint16_t>(rxNowMs + 100 - 51996),
+                       rxNowMs + 100) &&
+         filter.lastAgeMs() == 0;
+}
+
+// Trips after kMissedHeartbeats periods of silence, once per silence, and
+// not before the first feed.
+bool checkDeadManTimer() {
+  DeadManTimer timer;
+  if (timer.expired(100000)) {
+    return false;
+  }
+  timer.feedHeartbeat(1000, 1000);
+  if (timer.timeoutMs() != 1000u * DeadManTimer::kMissedHeartbeats ||
+      timer.expired(3999) || !timer.expired(4000) || timer.expired(4001) ||
+      timer.expired(60000) || timer.trips() != 1) {
+    return false;
+  }
+  // A period of 0 keeps the timeout; millis() may wrap during a silence.
+  uint32_t nowMs = 0xFFFFF000u;
+  timer.feedHeartbeat(nowMs, 0);
+  return !timer.expired(nowMs + 2999) && timer.expired(nowMs + 3000) &&
+         !timer.expired(nowMs + 3001) && timer.trips() == 2;
+}
+
+// Feeds text until the parser completes an event; false if the text ran
+// out first. text is left after the last byte consumed.
+template <size_t N>
+bool nextEvent(SseParser<N> &parser, const char *&text) {
+  while (*text != '\0') {
+    if (parser.feed(static_cast<uint8_t>(*text++))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Multi-line data, comments, CRLF line ends, events without data, and an
+// event too large for the buffer that is flagged rather than cut.
+bool checkSseParser() {
+  SseParser<16> parser;
+  const char *stream =
+      ": ping\r\n\r\n"
+      "event: status\r\nid: 42\r\ndata: {\"v\":\r\ndata: 1}\r\n\r\n"
+      ": ping\n"
+      "event: empty\n\n"
+      "data: 0123456789abcdefXYZ\n\n"
+      "data:plain\n\n";
+  if (!nextEvent(parser, stream) || !parser.isEvent("status") ||
+      !parser.hasId() || parser.id() != 42 ||
+      strcmp(parser.data(), "{\"v\":\n1}") != 0 || parser.truncated()) {
+    return false;
+  }
+  if (!nextEvent(parser, stream) || !parser.truncated() ||
+      parser.dataLength() != 16) {
+    return false;
+  }
+  if (!nextEvent(parser, stream) || !parser.isEvent("message") ||
+      strcmp(parser.data(), "plain") != 0 || parser.truncated() ||
+      parser.hasId()) {
+    return false;
+  }
+  return !nextEvent(parser, stream) && parser.events() == 3 &&
+         parser.comments() == 2;
+}
+
+// Feeds text and returns the body bytes the parser reported.
+std::string feedHttp(HttpResponseParser &parser, const char *text) {
+  std::string body;
+  for (; *text != '\0'; ++text) {
+    if (parser.feed(static_cast<uint8_t>(*text))) {
+      body += *text;
+    }
+  }
+  return body;
+}
+
+// Chunked and Content-Length bodies, 304 without a body, close-framed
+// bodies, and responses cut short or malformed.
+bool checkHttpResponseParser() {
+  HttpResponseParser parser;
+  parser.reset();
+  std::string body = feedHttp(parser,
+                              "HTTP/1.1 200 OK\r\n"
+                              "Transfer-Encoding: chunked\r\n"
+                              "X-Held-Ms: 12\r\n\r\n"
+                              "5\r\nhello\r\n7;ext=1\r\n, world\r\n0\r\n\r\n");
+  if (body != "hello, world" || !parser.done() || !parser.chunked() ||
+      parser.heldMs() != 12 || !parser.keepAlive()) {
+    return false;
+  }
+  // 304 ends at the blank line whatever Content-Length says; what follows
+  // belongs to the next response.
+  parser.reset();
+  body = feedHttp(parser,
+                  "HTTP/1.1 304 Not Modified\r\n"
+                  "Content-Length: 57\r\n\r\n"
+                  "HTTP/1.1");
+  if (!body.empty() || !parser.done() || parser.status() != 304 ||
+      parser.bodyBytes() != 0 || !parser.keepAlive()) {
+    return false;
+  }
+  parser.reset();
+  body = feedHttp(parser,
+                  "HTTP/1.0 200 OK\r\nContent-Length: 3\r\n\r\nabcdef");
+  if (body != "abc" || !parser.done() || parser.keepAlive()) {
+    return false;
+  }
+  parser.reset();
+  body = feedHttp(parser, "HTTP/1.1 200 OK\r\n\r\nxyz");
+  parser.closed();
+  if (body != "xyz" || !parser.done() || parser.keepAlive()) {
+    return false;
+  }
+  parser.reset();
+  feedHttp(parser, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc");
+  parser.closed();
+  if (!parser.failed()) {
+    return false;
+  }
+  parser.reset();
+  feedHttp(parser,
+           "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+           "zz\r\n");
+  return parser.failed();
+}
+
+struct Check {
+  const char *name;
+  bool ok;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  std::mt19937 rng(0x54414E4B);
+  CipherSession session;
+  const Check checks[] = {
+      {"crc_engines_match", checkCrcEngines(rng)},
+      {"cipher_paths_match", session.begin() && checkCipherPaths(session)},
+      {"airtime_model_match", checkAirtimeModel()},
+      {"status_binary_roundtrip", checkStatusBinary()},
+      {"replay_window", checkReplayWindow()},
+      {"ack_nonce_per_vehicle", session.ready() && checkAckPerVehicle(session)},
+      {"trajectory_v2", session.ready() && checkTrajectoryV2(session)},
+      {"staleness_filter", checkStalenessFilter()},
+      {"dead_man_timer", checkDeadManTimer()},
+      {"sse_parser", checkSseParser()},
+      {"http_response_parser", checkHttpResponseParser()},
+  };
+
+  uint8_t data[256];
+  for (uint8_t &b : data) {
+    b = static_cast<uint8_t>(rng());
+  }
+
+  run("crc32_bitwise_12B", 12, iterations,
+      [&](uint64_t i) { gSink += crc32Bitwise(data + (i & 7), 12); });
+  run("crc32_slice4_12B", 12, iterations,
+      [&](uint64_t i) { gSink += crc32Slice4(data + (i & 7), 12); });
+  run("crc32_slice8_12B", 12, iterations,
+      [&](uint64_t i) { gSink += crc32Slice8(data + (i & 7), 12); });
+  run("crc32_bitwise_60B", 60, iterations,
+      [&](uint64_t i) { gSink += crc32Bitwise(data + (i & 7), 60); });
+  run("crc32_slice4_60B", 60, iterations,
+      [&](uint64_t i) { gSink += crc32Slice4(data + (i & 7), 60); });
+  run("crc32_slice8_60B", 60, iterations,
+      [&](uint64_t i) { gSink += crc32Slice8(data + (i & 7), 60); });
+  run("crc32_bitwise_192B", 192, iterations,
+      [&](uint64_t i) { gSink += crc32Bitwise(data + (i & 7), 192); });
+  run("crc32_slice8_192B", 192, iterations,
+      [&](uint64_t i) { gSink += crc32Slice8(data + (i & 7), 192); });
+
+  ControlFrame frame;
+  run("initFrame", kFrameSize, iterations, [&](uint64_t i) {
+    initFrame(frame, Command::Forward, 200, 200, static_cast<uint32_t>(i));
+    gSink += frame.crc32;
+  });
+
+  uint8_t encrypted[kFrameSize];
+  initFrame(frame, Command::Forward, 200, 200, 1);
+  run("encryptFrame", kFrameSize, iterations, [&](uint64_t) {
+    gSink += encryptFrame(frame, encrypted, sizeof(encrypted));
+  });
+  ControlFrame decoded;
+  run("decryptFrame", kFrameSize, iterations, [&](uint64_t) {
+    gSink += decryptFrame(encrypted, sizeof(encrypted), decoded);
+  });
+  run("session_encrypt", kFrameSize, iterations, [&](uint64_t) {
+    gSink += session.encrypt(frame, encrypted, sizeof(encrypted));
+  });
+  run("session_decrypt", kFrameSize, iterations, [&](uint64_t) {
+    gSink += session.decrypt(encrypted, sizeof(encrypted), decoded);
+  });
+
+  static constexpr size_t kBatch = 8;
+  ControlFrame frames[kBatch];
+  ControlFrame decodedBatch[kBatch];
+  uint8_t batch[kBatch * kFrameSize];
+  for (size_t i = 0; i < kBatch; ++i) {
+    initFrame(frames[i], Command::Forward, 200, 200, static_cast<uint32_t>(i));
+  }
+  uint64_t batchIterations = iterations / kBatch + 1;
+  run("session_encrypt_batch8", kFrameSize, batchIterations, [&](uint64_t) {
+    gSink += session.encryptBatch(frames, kBatch, batch, sizeof(batch));
+  });
+  gResults.back().nsPerFrame /= kBatch;
+  run("session_decrypt_batch8", kFrameSize, batchIterations, [&](uint64_t) {
+    gSink += session.decryptBatch(batch, kBatch, decodedBatch);
+  });
+  gResults.back().nsPerFrame /= kBatch;
+
+  uint8_t inPlace[kFrameSize];
+  session.encrypt(frame, encrypted, sizeof(encrypted));
+  run("session_open_in_place", kFrameSize, iterations, [&](uint64_t) {
+    memcpy(inPlace, encrypted, sizeof(inPlace));
+    gSink += session.openInPlace(inPlace, sizeof(inPlace)).valid();
+  });
+
+  uint8_t sealed[kAeadFrameSize];
+  run("v2_seal", kAeadFrameSize, iterations, [&](uint64_t i) {
+    frame.sequence = static_cast<uint32_t>(i);
+    gSink += session.sealV2(frame, 1, static_cast<uint16_t>(i), sealed,
+                            sizeof(sealed));
+  });
+  run("v2_open", kAeadFrameSize, iterations, [&](uint64_t) {
+    gSink += session.openV2(sealed, sizeof(sealed), decoded);
+  });
+
+  AckTelemetry ack = {1, 1, -97, -30, 64, 64, 0};
+  uint8_t ackFrame[kAckFrameSize];
+  run("ack_seal", kAckFrameSize, iterations, [&](uint64_t i) {
+    ack.sequence = static_cast<uint32_t>(i);
+    gSink += session.sealAck(ack, ackFrame, sizeof(ackFrame));
+  });
+  run("ack_open", kAckFrameSize, iterations, [&](uint64_t) {
+    gSink += session.openAck(ackFrame, sizeof(ackFrame), ack);
+  });
+
+  uint8_t heartbeat[kHeartbeatFrameSize];
+  uint32_t heartbeatSequence = 0;
+  uint16_t periodMs = 0;
+  run("heartbeat_seal", kHeartbeatFrameSize, iterations, [&](uint64_t i) {
+    gSink += session.sealHeartbeat(static_cast<uint32_t>(i), 1000, heartbeat,
+                                   sizeof(heartbeat));
+  });
+  run("heartbeat_open", kHeartbeatFrameSize, iterations, [&](uint64_t) {
+    gSink += session.openHeartbeat(heartbeat, sizeof(heartbeat),
+                                   heartbeatSequence, heartbeatSequence,
+                                   periodMs);
+  });
+
+  TrajectorySegment segments[kMaxTrajectorySegments];
+  for (size_t i = 0; i < kMaxTrajectorySegments; ++i) {
+    segments[i] = {static_cast<uint8_t>(Command::Forward), 180, 180, 250};
+  }
+  TrajectoryPacket packet;
+  initTrajectory(packet, segments, kMaxTrajectorySegments, 1);
+  uint8_t trajectory[kTrajectoryPacketSize];
+  run("trajectory_encrypt", kTrajectoryPacketSize, iterations, [&](uint64_t) {
+    gSink += session.encryptTrajectory(packet, trajectory, sizeof(trajectory));
+  });
+  run("trajectory_decrypt", kTrajectoryPacketSize, iterations, [&](uint64_t) {
+    gSink += session.decryptTrajectory(trajectory, sizeof(trajectory), packet);
+  });
+  uint8_t trajectoryV2[kAeadTrajectoryMaxFrameSize];
+  run("trajectory_v2_seal", kAeadTrajectoryMaxFrameSize, iterations,
+      [&](uint64_t) {
+        gSink += session.sealTrajectoryV2(packet, 0, trajectoryV2,
+                                          sizeof(trajectoryV2));
+      });
+  run("trajectory_v2_open", kAeadTrajectoryMaxFrameSize, iterations,
+      [&](uint64_t) {
+        gSink += session.openTrajectoryV2(trajectoryV2, sizeof(trajectoryV2),
+                                          packet);
+      });
+
+  uint8_t status[statusBinaryCapacity(1)];
+  size_t statusLength = writeStatusBinary(status, sizeof(status));
+  run("status_bin_decode", statusLength, iterations,
+      [&](uint64_t) { gSink += readStatusBinary(status, statusLength); });
+
+  printf("{\n  \"iterations\": %llu,\n",
+         static_cast<unsigned long long>(iterations));
+  bool allOk = true;
+  printf("  \"checks\": {");
+  for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i) {
+    printf("%s\"%s\": %s", i ? ", " : "", checks[i].name,
+           checks[i].ok ? "true" : "false");
+    allOk = allOk && checks[i].ok;
+  }
+  printf("},\n");
+  printf("  \"results\": [\n");
+  for (size_t i = 0; i < gResults.size(); ++i) {
+    const Result &r = gResults[i];
+    printf("    {\"name\": \"%s\", \"bytes\": %zu, \"ns_per_frame\": %.1f, "
+           "\"frames_per_sec\": %.0f}%s\n",
+           r.name, r.bytes, r.nsPerFrame, 1e9 / r.nsPerFrame,
+           i + 1 < gResults.size() ? "," : "");
+  }
+  printf("  ]\n}\n");
+
+  return allOk ? 0 : 1;
+}
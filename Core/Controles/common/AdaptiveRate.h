@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Airtime.h"
+
+#include <math.h>
+
+// Adaptive data rate: picks the lowest-airtime radio profile whose measured
+// link margin and packet loss stay within target. The controller only
+// decides; switching both ends over is the caller's job (see the SetRadio
+// handshake in LoRaControlProtocol.md).
+
+namespace TankControl {
+
+// Minimum demodulation SNR per spreading factor (SX1276 datasheet).
+inline float demodFloorSnrDb(uint8_t spreadingFactor) {
+  return -2.5f * (static_cast<int>(spreadingFactor) - 4);
+}
+
+// Receiver sensitivity: SX1276 figures for 125 kHz, 3 dB worse per doubling
+// of bandwidth.
+inline float sensitivityDbm(const RadioProfile &profile) {
+  static const float kSensitivity125kDbm[] = {-118.0f, -123.0f, -126.0f,
+                                              -129.0f, -132.0f, -134.5f,
+                                              -137.0f};
+  uint8_t sf = profile.spreadingFactor < 6 ? 6
+               : profile.spreadingFactor > 12 ? 12
+                                              : profile.spreadingFactor;
+  return kSensitivity125kDbm[sf - 6] +
+         10.0f * log10f(profile.bandwidthHz / 125000.0f);
+}
+
+// Link margin a profile would have, given the worst SNR/RSSI measured on
+// the current one. SNR scales with bandwidth (noise power), RSSI does not.
+inline float predictedMarginDb(const RadioProfile &current,
+                               const RadioProfile &candidate, float snrDb,
+                               float rssiDbm) {
+  float bandwidthRatio =
+      static_cast<float>(candidate.bandwidthHz) / current.bandwidthHz;
+  float snr = snrDb - 10.0f * log10f(bandwidthRatio);
+  float snrMargin = snr - demodFloorSnrDb(candidate.spreadingFactor);
+  float rssiMargin = rssiDbm - sensitivityDbm(candidate);
+  return snrMargin < rssiMargin ? snrMargin : rssiMargin;
+}
+
+class AdaptiveRate {
+ public:
+  static constexpr size_t kMaxSteps = 9;
+
+  // Builds the ladder from fastest to most robust: SF7..SF12 at the base
+  // bandwidth, preceded by SF7 at 500 and 250 kHz when allowBandwidth is
+  // set. Starts on the step matching base.
+  AdaptiveRate(const RadioProfile &base, bool allowBandwidth) {
+    if (allowBandwidth) {
+      for (uint32_t bw = 500000; bw > base.bandwidthHz; bw /= 2) {
+        addStep(base, 7, bw);
+      }
+    }
+    for (uint8_t sf = 7; sf <= 12; ++sf) {
+      addStep(base, sf, base.bandwidthHz);
+    }
+    for (size_t i = 0; i < steps_; ++i) {
+      if (ladder_[i].spreadingFactor == base.spreadingFactor &&
+          ladder_[i].bandwidthHz == base.bandwidthHz) {
+        current_ = home_ = i;
+      }
+    }
+  }
+
+  void setTargets(float marginDb, uint8_t maxLossPercent) {
+    targetMarginDb_ = marginDb;
+    maxLossPercent_ = maxLossPercent;
+  }
+
+  size_t steps() const { return steps_; }
+  const RadioProfile &step(size_t i) const { return ladder_[i]; }
+  size_t current() const { return current_; }
+  size_t home() const { return home_; }
+  const RadioProfile &profile() const { return ladder_[current_]; }
+  void setCurrent(size_t i) {
+    current_ = i < steps_ ? i : current_;
+    resetWindow();
+  }
+
+  // One ACK: how the peer heard us and how we heard its reply. The worst of
+  // each over the window drives the decision.
+  void addSample(float snrDb, float rssiDbm) {
+    if (samples_ == 0 || snrDb < worstSnrDb_) {
+      worstSnrDb_ = snrDb;
+    }
+    if (samples_ == 0 || rssiDbm < worstRssiDbm_) {
+      worstRssiDbm_ = rssiDbm;
+    }
+    ++samples_;
+  }
+
+  // Called once per evaluation window with the frames delivered and lost in
+  // it. Returns the step to move to (current() to stay): one step more
+  // robust when loss or margin is out of bounds, one step faster when the
+  // faster profile would still clear the margin plus hysteresis.
+  size_t evaluate(uint32_t delivered, uint32_t lost) {
+    size_t next = current_;
+    uint32_t total = delivered + lost;
+    if (samples_ > 0) {
+      lastMarginDb_ = predictedMarginDb(ladder_[current_], ladder_[current_],
+                                        worstSnrDb_, worstRssiDbm_);
+    }
+    bool lossy = total > 0 && lost * 100 > total * maxLossPercent_;
+    if (samples_ > 0 && (lossy || lastMarginDb_ < targetMarginDb_)) {
+      next = current_ + 1 < steps_ ? current_ + 1 : current_;
+    } else if (samples_ >= kMinSamples && current_ > 0 &&
+               lost * 200 <= total * maxLossPercent_ &&
+               predictedMarginDb(ladder_[current_], ladder_[current_ - 1],
+                                 worstSnrDb_, worstRssiDbm_) >=
+                   targetMarginDb_ + kHysteresisDb) {
+      next = current_ - 1;
+    }
+    resetWindow();
+    return next;
+  }
+
+  float lastMarginDb() const { return lastMarginDb_; }
+
+ private:
+  static constexpr uint32_t kMinSamples = 4;
+  static constexpr float kHysteresisDb = 3.0f;
+
+  void addStep(const RadioProfile &base, uint8_t sf, uint32_t bandwidthHz) {
+    if (steps_ == kMaxSteps) {
+      return;
+    }
+    RadioProfile &p = ladder_[steps_++];
+    p = base;
+    p.spreadingFactor = sf;
+    p.bandwidthHz = bandwidthHz;
+  }
+
+  void resetWindow() { samples_ = 0; }
+
+  RadioProfile ladder_[kMaxSteps];
+  size_t steps_ = 0;
+  size_t current_ = 0;
+  size_t home_ = 0;
+  float targetMarginDb_ = 10.0f;
+  uint8_t maxLossPercent_ = 10;
+  float worstSnrDb_ = 0;
+  float worstRssiDbm_ = 0;
+  uint32_t samples_ = 0;
+  float lastMarginDb_ = 0;
+};
+
+}  // namespace TankControl
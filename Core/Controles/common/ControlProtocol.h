@@ -1,7 +1,11 @@
 #pragma once
 
-#include <Arduino.h>
+#include "Platform.h"
 #include <mbedtls/aes.h>
+#include <mbedtls/ccm.h>
+
+#include "Crc32.h"
+#include "FrameSchema.h"
 
 namespace TankControl {
 
@@ -9,6 +13,94 @@ constexpr uint8_t kMagic[4] = {'T', 'A', 'N', 'K'};
 constexpr uint8_t kProtocolVersion = 1;
 constexpr size_t kFrameSize = 16;
 
+// Protocol v2: AES-256-CCM frames. The version byte, destination vehicle
+// and sequence travel in clear as associated data, the command/speed bytes
+// are encrypted and a 4-byte CCM tag replaces the CRC-32.
+constexpr uint8_t kProtocolVersionAead = 2;
+
+// Fleet addressing. Vehicles are numbered from 1; frames for vehicle 0 are
+// obeyed by every vehicle (safety stops). v1 frames carry no address and
+// count as broadcast.
+constexpr uint8_t kBroadcastVehicle = 0;
+
+using AeadHeaderSchema = FrameSchema<Scalar<uint8_t>, Scalar<uint8_t>,
+                                     Scalar<uint32_t>, Scalar<uint16_t>>;
+enum AeadHeaderField : size_t {
+  kAeadVersionField,
+  kAeadVehicleField,
+  kAeadSequenceField,
+  kAeadTxTimeField
+};
+
+using AeadPayloadSchema =
+    FrameSchema<Scalar<uint8_t>, Scalar<uint8_t>, Scalar<uint8_t>>;
+enum AeadPayloadField : size_t {
+  kPayloadCommandField,
+  kPayloadLeftSpeedField,
+  kPayloadRightSpeedField
+};
+
+constexpr size_t kAeadHeaderSize = AeadHeaderSchema::kSize;
+constexpr size_t kAeadPayloadSize = AeadPayloadSchema::kSize;
+constexpr size_t kAeadTagSize = 4;
+constexpr size_t kAeadFrameSize =
+    kAeadHeaderSize + kAeadPayloadSize + kAeadTagSize;
+constexpr size_t kAeadNonceSize = 13;
+
+// ACK/telemetry frame, RX -> TX, sealed like v2: kind byte, the sending
+// vehicle and the acked sequence in clear (authenticated), link and motor
+// state encrypted. The kind byte and vehicle also go into the nonce, so an
+// ACK never reuses the nonce of the command frame it acknowledges, and two
+// vehicles never share one.
+constexpr uint8_t kAckFrameKind = 0xA1;
+
+using AckHeaderSchema =
+    FrameSchema<Scalar<uint8_t>, Scalar<uint8_t>, Scalar<uint32_t>>;
+enum AckHeaderField : size_t {
+  kAckKindField,
+  kAckVehicleField,
+  kAckSequenceField
+};
+
+using AckPayloadSchema =
+    FrameSchema<Scalar<int16_t>, Scalar<int8_t>, Scalar<int8_t>,
+                Scalar<int8_t>, Scalar<uint8_t>>;
+enum AckPayloadField : size_t {
+  kAckRssiField,
+  kAckSnrField,
+  kAckLeftMotorField,
+  kAckRightMotorField,
+  kAckStatusField
+};
+
+constexpr size_t kAckHeaderSize = AckHeaderSchema::kSize;
+constexpr size_t kAckPayloadSize = AckPayloadSchema::kSize;
+constexpr size_t kAckFrameSize =
+    kAckHeaderSize + kAckPayloadSize + kAeadTagSize;
+
+// AckTelemetry::status bits.
+constexpr uint8_t kAckStatusTrajectoryActive = 0x01;
+constexpr uint8_t kAckStatusStale = 0x02;  // authenticated but not applied
+
+// Heartbeat, TX -> RX, broadcast and never acknowledged. The kind byte and
+// the low 16 bits of the sequence travel in clear (authenticated); the RX
+// restores the upper bits from its replay window. The one encrypted byte is
+// the TX heartbeat period in kHeartbeatPeriodUnitMs, from which the RX
+// derives its dead-man timeout. At 8 bytes it is the shortest sealed frame.
+constexpr uint8_t kHeartbeatFrameKind = 0xA2;
+constexpr uint16_t kHeartbeatPeriodUnitMs = 10;
+
+using HeartbeatHeaderSchema = FrameSchema<Scalar<uint8_t>, Scalar<uint16_t>>;
+enum HeartbeatHeaderField : size_t {
+  kHeartbeatKindField,
+  kHeartbeatSequenceField
+};
+
+constexpr size_t kHeartbeatHeaderSize = HeartbeatHeaderSchema::kSize;
+constexpr size_t kHeartbeatPayloadSize = 1;
+constexpr size_t kHeartbeatFrameSize =
+    kHeartbeatHeaderSize + kHeartbeatPayloadSize + kAeadTagSize;
+
 // AES-256-CBC shared secrets (replace in production).
 const uint8_t kAesKey[32] = {
     0x51, 0x2A, 0xCE, 0x77, 0x48, 0x93, 0x11, 0xBA,
@@ -20,13 +112,37 @@ const uint8_t kAesIv[16] = {
     0x44, 0x1E, 0xF9, 0xBC, 0x2A, 0x0D, 0x77, 0x63,
     0x9C, 0x53, 0x4B, 0x10, 0xAB, 0x88, 0xFE, 0x21};
 
+// Fixed prefix of the 13-byte CCM nonce; the frame version or kind, a
+// vehicle id and the 32-bit sequence fill the remaining bytes, so a sequence
+// must never repeat under one key.
+const uint8_t kAeadNonceSalt[7] = {
+    0x6B, 0x3D, 0x90, 0xE2, 0x15, 0xC8, 0x4F};
+
+// Sequence numbers are (epoch << 16) | counter. The TX keeps its epoch in
+// flash and moves it on at every boot and whenever the counter wraps, so no
+// sequence, and hence no nonce, is used twice under one key, reboots
+// included. Epoch 0 is never used; once epoch 0xFFFF runs out the TX stops
+// sending until it gets a new key.
+constexpr uint32_t kSequenceEpochShift = 16;
+
+inline uint16_t sequenceEpoch(uint32_t sequence) {
+  return static_cast<uint16_t>(sequence >> kSequenceEpochShift);
+}
+
+inline uint32_t firstSequence(uint16_t epoch) {
+  return static_cast<uint32_t>(epoch) << kSequenceEpochShift;
+}
+
 enum class Command : uint8_t {
   Stop = 0,
   Forward = 1,
   Backward = 2,
   Left = 3,
   Right = 4,
-  SetSpeed = 5
+  SetSpeed = 5,
+  Trajectory = 6,
+  Drive = 7,
+  SetRadio = 8
 };
 
 #pragma pack(push, 1)
@@ -36,35 +152,142 @@ struct ControlFrame {
   uint8_t command;
   uint8_t leftSpeed;
   uint8_t rightSpeed;
-  uint8_t sequence;
-  uint8_t reserved[3];
+  uint32_t sequence;
   uint32_t crc32;
 };
 #pragma pack(pop)
 
-inline uint32_t crc32(const uint8_t *data, size_t length) {
-  uint32_t crc = 0xFFFFFFFFu;
-  for (size_t i = 0; i < length; ++i) {
-    crc ^= static_cast<uint32_t>(data[i]);
-    for (uint8_t j = 0; j < 8; ++j) {
-      uint32_t mask = -(crc & 1u);
-      crc = (crc >> 1) ^ (0xEDB88320u & mask);
-    }
-  }
-  return ~crc;
+static_assert(sizeof(ControlFrame) == kFrameSize,
+              "ControlFrame must fill exactly one AES block");
+
+// Field-level description of the same 16 bytes. Used for zero-copy reads on
+// the RX path and to derive the CRC coverage instead of hard-coding it.
+using ControlFrameSchema =
+    FrameSchema<Bytes<4>, Scalar<uint8_t>, Scalar<uint8_t>, Scalar<uint8_t>,
+                Scalar<uint8_t>, Scalar<uint32_t>, Scalar<uint32_t>>;
+enum ControlFrameField : size_t {
+  kMagicField,
+  kVersionField,
+  kCommandField,
+  kLeftSpeedField,
+  kRightSpeedField,
+  kSequenceField,
+  kCrc32Field
+};
+using ControlFrameView = FrameView<ControlFrameSchema>;
+
+static_assert(ControlFrameSchema::kSize == sizeof(ControlFrame),
+              "ControlFrameSchema out of sync with ControlFrame");
+static_assert(ControlFrameSchema::offset<kSequenceField>() ==
+                  offsetof(ControlFrame, sequence),
+              "ControlFrameSchema out of sync with ControlFrame");
+static_assert(ControlFrameSchema::offset<kCrc32Field>() ==
+                  offsetof(ControlFrame, crc32),
+              "ControlFrameSchema out of sync with ControlFrame");
+
+// Bytes 0-11: everything before the CRC field.
+constexpr size_t kFrameCrcCoverage = ControlFrameSchema::offset<kCrc32Field>();
+
+// Multi-command packet: a timed sequence of drive segments that the RX plays
+// back from its own clock, so a whole manoeuvre costs one preamble and
+// header on air instead of one per command.
+constexpr size_t kMaxTrajectorySegments = 8;
+constexpr size_t kTrajectoryPacketSize = 64;
+
+#pragma pack(push, 1)
+struct TrajectorySegment {
+  uint8_t command;
+  uint8_t leftSpeed;
+  uint8_t rightSpeed;
+  uint16_t durationMs;
+};
+
+struct TrajectoryPacket {
+  ControlFrame header;  // command = Trajectory, leftSpeed = segment count
+  TrajectorySegment segments[kMaxTrajectorySegments];
+  uint8_t vehicle;  // destination, kBroadcastVehicle for everyone
+  uint8_t reserved[3];
+  uint32_t crc32;  // CRC-32 of bytes 0-59
+};
+#pragma pack(pop)
+
+using TrajectorySegmentSchema = FrameSchema<Scalar<uint8_t>, Scalar<uint8_t>,
+                                            Scalar<uint8_t>, Scalar<uint16_t>>;
+using TrajectoryPacketSchema = FrameSchema<
+    Bytes<kFrameSize>,
+    Bytes<kMaxTrajectorySegments * TrajectorySegmentSchema::kSize>,
+    Scalar<uint8_t>, Bytes<3>, Scalar<uint32_t>>;
+
+static_assert(sizeof(TrajectoryPacket) == kTrajectoryPacketSize,
+              "TrajectoryPacket must fill exactly four AES blocks");
+static_assert(TrajectorySegmentSchema::kSize == sizeof(TrajectorySegment),
+              "TrajectorySegmentSchema out of sync with TrajectorySegment");
+static_assert(TrajectoryPacketSchema::kSize == sizeof(TrajectoryPacket),
+              "TrajectoryPacketSchema out of sync with TrajectoryPacket");
+
+// Bytes 0-59: everything before the trailing CRC field.
+constexpr size_t kTrajectoryCrcCoverage = TrajectoryPacketSchema::offset<4>();
+
+// Protocol v2 trajectory frame: the v2 header with kTrajectoryFrameKind in
+// the version byte, then the segment count and only the segments in use,
+// encrypted, then the 4-byte tag. It takes the 64-byte CBC packet's place
+// in v2 builds, so trajectories get a per-frame nonce and a real MAC too.
+constexpr uint8_t kTrajectoryFrameKind = 0xA3;
+
+constexpr size_t aeadTrajectoryFrameSize(size_t segments) {
+  return kAeadHeaderSize + 1 + segments * TrajectorySegmentSchema::kSize +
+         kAeadTagSize;
 }
 
+constexpr size_t kAeadTrajectoryMaxFrameSize =
+    aeadTrajectoryFrameSize(kMaxTrajectorySegments);
+static_assert(kAeadTrajectoryMaxFrameSize <= kTrajectoryPacketSize,
+              "v2 trajectories must fit wherever a v1 packet does");
+
+// Decoded ACK/telemetry frame. rssiDbm/snrQuarterDb describe how the RX
+// heard the acked frame; leftMotor/rightMotor are the signed drive outputs
+// (-127..127) it is applying now.
+struct AckTelemetry {
+  uint32_t sequence;
+  uint8_t vehicle;  // the acknowledging RX
+  int16_t rssiDbm;
+  int8_t snrQuarterDb;
+  int8_t leftMotor;
+  int8_t rightMotor;
+  uint8_t status;
+};
+
 inline void initFrame(ControlFrame &frame, Command command,
                       uint8_t leftSpeed, uint8_t rightSpeed,
-                      uint8_t sequence) {
+                      uint32_t sequence) {
   memcpy(frame.magic, kMagic, sizeof(kMagic));
   frame.version = kProtocolVersion;
   frame.command = static_cast<uint8_t>(command);
   frame.leftSpeed = leftSpeed;
   frame.rightSpeed = rightSpeed;
   frame.sequence = sequence;
-  memset(frame.reserved, 0, sizeof(frame.reserved));
-  frame.crc32 = crc32(reinterpret_cast<const uint8_t *>(&frame), 12);
+  frame.crc32 =
+      crc32(reinterpret_cast<const uint8_t *>(&frame), kFrameCrcCoverage);
+}
+
+inline bool validateFrame(const ControlFrameView &frame) {
+  if (!frame.valid()) {
+    return false;
+  }
+  if (memcmp(frame.get<kMagicField>(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  if (frame.get<kVersionField>() != kProtocolVersion) {
+    return false;
+  }
+
+  uint32_t expected = crc32(frame.data(), kFrameCrcCoverage);
+  return expected == frame.get<kCrc32Field>();
+}
+
+inline bool validateFrame(const ControlFrame &frame) {
+  return validateFrame(ControlFrameView(
+      reinterpret_cast<const uint8_t *>(&frame), sizeof(ControlFrame)));
 }
 
 inline bool encryptFrame(const ControlFrame &frame, uint8_t *outputBuffer,
@@ -121,18 +344,860 @@ inline bool decryptFrame(const uint8_t *inputBuffer, size_t bufferLength,
   }
 
   memcpy(&frameOut, workBuffer, sizeof(ControlFrame));
+  return validateFrame(frameOut);
+}
+
+// Differential-drive vector frame: leftSpeed/rightSpeed carry signed
+// per-wheel velocities (int8, -127 full reverse .. 127 full forward), so one
+// frame fully describes the drive state without a separate SetSpeed.
+inline void initDriveFrame(ControlFrame &frame, int8_t leftVelocity,
+                           int8_t rightVelocity, uint32_t sequence) {
+  initFrame(frame, Command::Drive, static_cast<uint8_t>(leftVelocity),
+            static_cast<uint8_t>(rightVelocity), sequence);
+}
+
+// Radio reconfiguration frame (adaptive data rate): leftSpeed carries the
+// spreading factor (6-12), rightSpeed the bandwidth as the SX127x
+// RegModemConfig1 code (0 = 7.8 kHz .. 7 = 125 kHz, 8 = 250, 9 = 500).
+constexpr uint8_t kBandwidthCodeCount = 10;
+
+inline uint32_t bandwidthFromCode(uint8_t code) {
+  static const uint32_t kBandwidthHz[kBandwidthCodeCount] = {
+      7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+  return code < kBandwidthCodeCount ? kBandwidthHz[code] : 0;
+}
+
+// Smallest code whose bandwidth is at least bandwidthHz.
+inline uint8_t bandwidthCode(uint32_t bandwidthHz) {
+  uint8_t code = 0;
+  while (code + 1 < kBandwidthCodeCount &&
+         bandwidthFromCode(code) < bandwidthHz) {
+    ++code;
+  }
+  return code;
+}
+
+inline void initSetRadioFrame(ControlFrame &frame, uint8_t spreadingFactor,
+                              uint32_t bandwidthHz, uint32_t sequence) {
+  initFrame(frame, Command::SetRadio, spreadingFactor,
+            bandwidthCode(bandwidthHz), sequence);
+}
+
+inline int8_t leftVelocity(const ControlFrame &frame) {
+  return static_cast<int8_t>(frame.leftSpeed);
+}
+
+inline int8_t rightVelocity(const ControlFrame &frame) {
+  return static_cast<int8_t>(frame.rightSpeed);
+}
 
-  if (memcmp(frameOut.magic, kMagic, sizeof(kMagic)) != 0) {
+// PWM duty (0-255) for the magnitude of a drive velocity; the sign selects
+// the H-bridge direction.
+inline uint8_t pwmFromVelocity(int8_t velocity) {
+  int magnitude = velocity < 0 ? -static_cast<int>(velocity) : velocity;
+  if (magnitude > 127) {
+    magnitude = 127;
+  }
+  return static_cast<uint8_t>(magnitude * 255 / 127);
+}
+
+inline bool initTrajectory(TrajectoryPacket &packet,
+                           const TrajectorySegment *segments, size_t count,
+                           uint32_t sequence,
+                           uint8_t vehicle = kBroadcastVehicle) {
+  if (!segments || count == 0 || count > kMaxTrajectorySegments) {
     return false;
   }
-  if (frameOut.version != kProtocolVersion) {
+  initFrame(packet.header, Command::Trajectory, static_cast<uint8_t>(count), 0,
+            sequence);
+  memset(packet.segments, 0, sizeof(packet.segments));
+  memcpy(packet.segments, segments, count * sizeof(TrajectorySegment));
+  packet.vehicle = vehicle;
+  memset(packet.reserved, 0, sizeof(packet.reserved));
+  packet.crc32 = crc32(reinterpret_cast<const uint8_t *>(&packet),
+                       kTrajectoryCrcCoverage);
+  return true;
+}
+
+inline bool validateTrajectory(const TrajectoryPacket &packet) {
+  if (!validateFrame(packet.header) ||
+      packet.header.command != static_cast<uint8_t>(Command::Trajectory) ||
+      packet.header.leftSpeed == 0 ||
+      packet.header.leftSpeed > kMaxTrajectorySegments) {
     return false;
   }
+  uint32_t expected = crc32(reinterpret_cast<const uint8_t *>(&packet),
+                            kTrajectoryCrcCoverage);
+  return expected == packet.crc32;
+}
+
+// True if a vehicle should act on a frame addressed to destination.
+inline bool addressedTo(uint8_t destination, uint8_t vehicle) {
+  return destination == kBroadcastVehicle || destination == vehicle;
+}
 
-  uint32_t expected = crc32(reinterpret_cast<const uint8_t *>(&frameOut), 12);
-  return expected == frameOut.crc32;
+// True if the RX answers an accepted frame of this wire version with an ACK,
+// and so if the TX waits for one. Broadcasts are not acknowledged: every
+// vehicle would answer at once and the replies would collide. v1 frames
+// carry no address but v1 cannot drive a fleet, so they are acknowledged.
+inline bool acknowledged(uint8_t version, uint8_t destination) {
+  return version != kProtocolVersionAead || destination != kBroadcastVehicle;
 }
 
+// Destination of a raw v2 command or trajectory frame, read from the clear
+// header so an RX can drop other vehicles' traffic before spending a CCM
+// decrypt on it. The address is only trustworthy once openV2() or
+// openTrajectoryV2() has authenticated the frame. Returns kBroadcastVehicle
+// for anything else.
+inline uint8_t peekVehicle(const uint8_t *inputBuffer, size_t bufferLength) {
+  FrameView<AeadHeaderSchema> header(inputBuffer, bufferLength);
+  if (!header.valid()) {
+    return kBroadcastVehicle;
+  }
+  uint8_t kind = header.get<kAeadVersionField>();
+  bool command =
+      kind == kProtocolVersionAead && bufferLength == kAeadFrameSize;
+  bool trajectory = kind == kTrajectoryFrameKind &&
+                    bufferLength >= aeadTrajectoryFrameSize(1) &&
+                    bufferLength <= kAeadTrajectoryMaxFrameSize;
+  return command || trajectory ? header.get<kAeadVehicleField>()
+                               : kBroadcastVehicle;
+}
+
+// Restores a 32-bit sequence from its low 16 bits, picking the value
+// closest to reference (the highest sequence accepted so far).
+inline uint32_t expandSequence(uint16_t low, uint32_t reference) {
+  uint32_t candidate = (reference & 0xFFFF0000u) | low;
+  int32_t delta = static_cast<int32_t>(candidate - reference);
+  if (delta > 0x8000) {
+    candidate -= 0x10000;
+  } else if (delta < -0x8000) {
+    candidate += 0x10000;
+  }
+  return candidate;
+}
+
+// Keeps the expanded AES-256 key schedules alive for the lifetime of the
+// node. encryptFrame()/decryptFrame() rebuild them on every call; a session
+// expands the key once in begin() and then only runs the block cipher.
+class CipherSession {
+ public:
+  CipherSession() {
+    mbedtls_aes_init(&encCtx_);
+    mbedtls_aes_init(&decCtx_);
+    mbedtls_ccm_init(&ccmCtx_);
+  }
+
+  ~CipherSession() {
+    mbedtls_aes_free(&encCtx_);
+    mbedtls_aes_free(&decCtx_);
+    mbedtls_ccm_free(&ccmCtx_);
+  }
+
+  CipherSession(const CipherSession &) = delete;
+  CipherSession &operator=(const CipherSession &) = delete;
+
+  bool begin(const uint8_t *key = kAesKey) {
+    ready_ = mbedtls_aes_setkey_enc(&encCtx_, key, 256) == 0 &&
+             mbedtls_aes_setkey_dec(&decCtx_, key, 256) == 0 &&
+             mbedtls_ccm_setkey(&ccmCtx_, MBEDTLS_CIPHER_ID_AES, key,
+                                256) == 0;
+    return ready_;
+  }
+
+  bool ready() const { return ready_; }
+
+  bool encrypt(const ControlFrame &frame, uint8_t *outputBuffer,
+               size_t bufferLength) {
+    return encryptBatch(&frame, 1, outputBuffer, bufferLength);
+  }
+
+  bool decrypt(const uint8_t *inputBuffer, size_t bufferLength,
+               ControlFrame &frameOut) {
+    if (!inputBuffer || bufferLength < kFrameSize) {
+      return false;
+    }
+    return decryptBatch(inputBuffer, 1, &frameOut) == 1;
+  }
+
+  // Encrypts frameCount frames back to back into outputBuffer
+  // (frameCount * kFrameSize bytes). Each frame is an independent CBC
+  // message, exactly as produced by encryptFrame().
+  bool encryptBatch(const ControlFrame *frames, size_t frameCount,
+                    uint8_t *outputBuffer, size_t bufferLength) {
+    if (!ready_ || !frames || !outputBuffer ||
+        bufferLength < frameCount * kFrameSize) {
+      return false;
+    }
+    for (size_t i = 0; i < frameCount; ++i) {
+      uint8_t workBuffer[kFrameSize];
+      memcpy(workBuffer, &frames[i], sizeof(ControlFrame));
+      uint8_t iv[16];
+      memcpy(iv, kAesIv, sizeof(iv));
+      if (mbedtls_aes_crypt_cbc(&encCtx_, MBEDTLS_AES_ENCRYPT, kFrameSize, iv,
+                                workBuffer,
+                                outputBuffer + i * kFrameSize) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Decrypts frameCount consecutive frames from inputBuffer. validOut
+  // (optional) receives the per-frame magic/version/CRC verdict; the return
+  // value is the number of valid frames.
+  size_t decryptBatch(const uint8_t *inputBuffer, size_t frameCount,
+                      ControlFrame *framesOut, bool *validOut = nullptr) {
+    if (!ready_ || !inputBuffer || !framesOut) {
+      return 0;
+    }
+    size_t validCount = 0;
+    for (size_t i = 0; i < frameCount; ++i) {
+      uint8_t workBuffer[kFrameSize];
+      uint8_t iv[16];
+      memcpy(iv, kAesIv, sizeof(iv));
+      bool valid = mbedtls_aes_crypt_cbc(&decCtx_, MBEDTLS_AES_DECRYPT,
+                                         kFrameSize, iv,
+                                         inputBuffer + i * kFrameSize,
+                                         workBuffer) == 0;
+      memcpy(&framesOut[i], workBuffer, sizeof(ControlFrame));
+      valid = valid && validateFrame(framesOut[i]);
+      if (validOut) {
+        validOut[i] = valid;
+      }
+      if (valid) {
+        ++validCount;
+      }
+    }
+    return validCount;
+  }
+
+  // Zero-copy v1 RX path: decrypts the 16-byte frame in place and returns a
+  // typed view over it (invalid if decryption or validation fails), so the
+  // fields are read straight from the packet buffer without a ControlFrame
+  // copy.
+  ControlFrameView openInPlace(uint8_t *buffer, size_t bufferLength) {
+    if (!ready_ || !buffer || bufferLength != kFrameSize) {
+      return ControlFrameView();
+    }
+    uint8_t iv[16];
+    memcpy(iv, kAesIv, sizeof(iv));
+    if (mbedtls_aes_crypt_cbc(&decCtx_, MBEDTLS_AES_DECRYPT, kFrameSize, iv,
+                              buffer, buffer) != 0) {
+      return ControlFrameView();
+    }
+    ControlFrameView view(buffer, bufferLength);
+    return validateFrame(view) ? view : ControlFrameView();
+  }
+
+  // Protocol v1 trajectory packets are a single 64-byte CBC message under
+  // the same key and IV, so their first block encrypts exactly like a lone
+  // ControlFrame. v2 builds use sealTrajectoryV2() instead.
+  bool encryptTrajectory(const TrajectoryPacket &packet, uint8_t *outputBuffer,
+                         size_t bufferLength) {
+    if (!ready_ || !outputBuffer || bufferLength < kTrajectoryPacketSize) {
+      return false;
+    }
+    uint8_t workBuffer[kTrajectoryPacketSize];
+    memcpy(workBuffer, &packet, sizeof(TrajectoryPacket));
+    uint8_t iv[16];
+    memcpy(iv, kAesIv, sizeof(iv));
+    return mbedtls_aes_crypt_cbc(&encCtx_, MBEDTLS_AES_ENCRYPT,
+                                 kTrajectoryPacketSize, iv, workBuffer,
+                                 outputBuffer) == 0;
+  }
+
+  bool decryptTrajectory(const uint8_t *inputBuffer, size_t bufferLength,
+                         TrajectoryPacket &packetOut) {
+    if (!ready_ || !inputBuffer || bufferLength != kTrajectoryPacketSize) {
+      return false;
+    }
+    uint8_t workBuffer[kTrajectoryPacketSize];
+    uint8_t iv[16];
+    memcpy(iv, kAesIv, sizeof(iv));
+    if (mbedtls_aes_crypt_cbc(&decCtx_, MBEDTLS_AES_DECRYPT,
+                              kTrajectoryPacketSize, iv, inputBuffer,
+                              workBuffer) != 0) {
+      return false;
+    }
+    memcpy(&packetOut, workBuffer, sizeof(TrajectoryPacket));
+    return validateTrajectory(packetOut);
+  }
+
+  // Protocol v2: writes a kAeadFrameSize-byte CCM frame for the command and
+  // speeds in frame, addressed to vehicle and stamped with the sender's
+  // clock (millis() truncated to 16 bits). Returns the number of bytes
+  // written, 0 on failure.
+  size_t sealV2(const ControlFrame &frame, uint8_t vehicle, uint16_t txTimeMs,
+                uint8_t *outputBuffer, size_t bufferLength) {
+    if (!ready_ || !outputBuffer || bufferLength < kAeadFrameSize) {
+      return 0;
+    }
+    FrameWriter<AeadHeaderSchema> header(outputBuffer, kAeadHeaderSize);
+    header.set<kAeadVersionField>(kProtocolVersionAead);
+    header.set<kAeadVehicleField>(vehicle);
+    header.set<kAeadSequenceField>(frame.sequence);
+    header.set<kAeadTxTimeField>(txTimeMs);
+
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kProtocolVersionAead, vehicle, frame.sequence, nonce);
+    uint8_t payload[kAeadPayloadSize];
+    FrameWriter<AeadPayloadSchema> plain(payload, sizeof(payload));
+    plain.set<kPayloadCommandField>(frame.command);
+    plain.set<kPayloadLeftSpeedField>(frame.leftSpeed);
+    plain.set<kPayloadRightSpeedField>(frame.rightSpeed);
+    int err = mbedtls_ccm_encrypt_and_tag(
+        &ccmCtx_, kAeadPayloadSize, nonce, sizeof(nonce), outputBuffer,
+        kAeadHeaderSize, payload, outputBuffer + kAeadHeaderSize,
+        outputBuffer + kAeadHeaderSize + kAeadPayloadSize, kAeadTagSize);
+    return err == 0 ? kAeadFrameSize : 0;
+  }
+
+  // Protocol v2: authenticates and decrypts a CCM frame. frameOut is filled
+  // with version kProtocolVersionAead and a zero crc32 (the tag replaces it);
+  // txTimeMsOut and vehicleOut (optional) receive the sender timestamp and
+  // the destination vehicle.
+  bool openV2(const uint8_t *inputBuffer, size_t bufferLength,
+              ControlFrame &frameOut, uint16_t *txTimeMsOut = nullptr,
+              uint8_t *vehicleOut = nullptr) {
+    FrameView<AeadHeaderSchema> header(inputBuffer, bufferLength);
+    if (!ready_ || !header.valid() || bufferLength != kAeadFrameSize ||
+        header.get<kAeadVersionField>() != kProtocolVersionAead) {
+      return false;
+    }
+    uint32_t sequence = header.get<kAeadSequenceField>();
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kProtocolVersionAead, header.get<kAeadVehicleField>(), sequence,
+               nonce);
+
+    uint8_t payload[kAeadPayloadSize];
+    int err = mbedtls_ccm_auth_decrypt(
+        &ccmCtx_, kAeadPayloadSize, nonce, sizeof(nonce), inputBuffer,
+        kAeadHeaderSize, inputBuffer + kAeadHeaderSize, payload,
+        inputBuffer + kAeadHeaderSize + kAeadPayloadSize, kAeadTagSize);
+    if (err != 0) {
+      return false;
+    }
+
+    FrameView<AeadPayloadSchema> plain(payload, sizeof(payload));
+    memcpy(frameOut.magic, kMagic, sizeof(kMagic));
+    frameOut.version = kProtocolVersionAead;
+    frameOut.command = plain.get<kPayloadCommandField>();
+    frameOut.leftSpeed = plain.get<kPayloadLeftSpeedField>();
+    frameOut.rightSpeed = plain.get<kPayloadRightSpeedField>();
+    frameOut.sequence = sequence;
+    frameOut.crc32 = 0;
+    if (txTimeMsOut) {
+      *txTimeMsOut = header.get<kAeadTxTimeField>();
+    }
+    if (vehicleOut) {
+      *vehicleOut = header.get<kAeadVehicleField>();
+    }
+    return true;
+  }
+
+  // Protocol v2: writes an aeadTrajectoryFrameSize(count)-byte CCM frame
+  // for a packet from initTrajectory(), addressed to packet.vehicle and
+  // stamped like sealV2(). Returns the number of bytes written, 0 on
+  // failure.
+  size_t sealTrajectoryV2(const TrajectoryPacket &packet, uint16_t txTimeMs,
+                          uint8_t *outputBuffer, size_t bufferLength) {
+    size_t count = packet.header.leftSpeed;
+    size_t length = aeadTrajectoryFrameSize(count);
+    if (!ready_ || !outputBuffer || count == 0 ||
+        count > kMaxTrajectorySegments || bufferLength < length) {
+      return 0;
+    }
+    FrameWriter<AeadHeaderSchema> header(outputBuffer, kAeadHeaderSize);
+    header.set<kAeadVersionField>(kTrajectoryFrameKind);
+    header.set<kAeadVehicleField>(packet.vehicle);
+    header.set<kAeadSequenceField>(packet.header.sequence);
+    header.set<kAeadTxTimeField>(txTimeMs);
+
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kTrajectoryFrameKind, packet.vehicle, packet.header.sequence,
+               nonce);
+    uint8_t payload[1 + sizeof(packet.segments)];
+    size_t payloadLength = length - kAeadHeaderSize - kAeadTagSize;
+    payload[0] = static_cast<uint8_t>(count);
+    memcpy(payload + 1, packet.segments, payloadLength - 1);
+    int err = mbedtls_ccm_encrypt_and_tag(
+        &ccmCtx_, payloadLength, nonce, sizeof(nonce), outputBuffer,
+        kAeadHeaderSize, payload, outputBuffer + kAeadHeaderSize,
+        outputBuffer + kAeadHeaderSize + payloadLength, kAeadTagSize);
+    return err == 0 ? length : 0;
+  }
+
+  // Protocol v2: authenticates and decrypts a trajectory frame. packetOut
+  // is filled the way openV2() fills a ControlFrame: version
+  // kProtocolVersionAead and zero CRCs, since the tag replaces them, so it
+  // does not pass validateTrajectory(). Unused segments are zeroed.
+  // txTimeMsOut (optional) receives the sender timestamp.
+  bool openTrajectoryV2(const uint8_t *inputBuffer, size_t bufferLength,
+                        TrajectoryPacket &packetOut,
+                        uint16_t *txTimeMsOut = nullptr) {
+    FrameView<AeadHeaderSchema> header(inputBuffer, bufferLength);
+    if (!ready_ || !header.valid() ||
+        header.get<kAeadVersionField>() != kTrajectoryFrameKind ||
+        bufferLength < aeadTrajectoryFrameSize(1) ||
+        bufferLength > kAeadTrajectoryMaxFrameSize) {
+      return false;
+    }
+    size_t payloadLength = bufferLength - kAeadHeaderSize - kAeadTagSize;
+    size_t count = (payloadLength - 1) / TrajectorySegmentSchema::kSize;
+    if (aeadTrajectoryFrameSize(count) != bufferLength) {
+      return false;
+    }
+    uint32_t sequence = header.get<kAeadSequenceField>();
+    uint8_t vehicle = header.get<kAeadVehicleField>();
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kTrajectoryFrameKind, vehicle, sequence, nonce);
+
+    uint8_t payload[1 + sizeof(packetOut.segments)];
+    int err = mbedtls_ccm_auth_decrypt(
+        &ccmCtx_, payloadLength, nonce, sizeof(nonce), inputBuffer,
+        kAeadHeaderSize, inputBuffer + kAeadHeaderSize, payload,
+        inputBuffer + kAeadHeaderSize + payloadLength, kAeadTagSize);
+    if (err != 0 || payload[0] != count) {
+      return false;
+    }
+
+    memcpy(packetOut.header.magic, kMagic, sizeof(kMagic));
+    packetOut.header.version = kProtocolVersionAead;
+    packetOut.header.command = static_cast<uint8_t>(Command::Trajectory);
+    packetOut.header.leftSpeed = static_cast<uint8_t>(count);
+    packetOut.header.rightSpeed = 0;
+    packetOut.header.sequence = sequence;
+    packetOut.header.crc32 = 0;
+    memset(packetOut.segments, 0, sizeof(packetOut.segments));
+    memcpy(packetOut.segments, payload + 1, payloadLength - 1);
+    packetOut.vehicle = vehicle;
+    memset(packetOut.reserved, 0, sizeof(packetOut.reserved));
+    packetOut.crc32 = 0;
+    if (txTimeMsOut) {
+      *txTimeMsOut = header.get<kAeadTxTimeField>();
+    }
+    return true;
+  }
+
+  // RX side: writes a kAckFrameSize-byte ACK for ack.sequence from
+  // ack.vehicle. Only acknowledged() frames get one. Returns the number of
+  // bytes written, 0 on failure.
+  size_t sealAck(const AckTelemetry &ack, uint8_t *outputBuffer,
+                 size_t bufferLength) {
+    if (!ready_ || !outputBuffer || bufferLength < kAckFrameSize) {
+      return 0;
+    }
+    FrameWriter<AckHeaderSchema> header(outputBuffer, kAckHeaderSize);
+    header.set<kAckKindField>(kAckFrameKind);
+    header.set<kAckVehicleField>(ack.vehicle);
+    header.set<kAckSequenceField>(ack.sequence);
+
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kAckFrameKind, ack.vehicle, ack.sequence, nonce);
+    uint8_t payload[kAckPayloadSize];
+    FrameWriter<AckPayloadSchema> plain(payload, sizeof(payload));
+    plain.set<kAckRssiField>(ack.rssiDbm);
+    plain.set<kAckSnrField>(ack.snrQuarterDb);
+    plain.set<kAckLeftMotorField>(ack.leftMotor);
+    plain.set<kAckRightMotorField>(ack.rightMotor);
+    plain.set<kAckStatusField>(ack.status);
+    int err = mbedtls_ccm_encrypt_and_tag(
+        &ccmCtx_, kAckPayloadSize, nonce, sizeof(nonce), outputBuffer,
+        kAckHeaderSize, payload, outputBuffer + kAckHeaderSize,
+        outputBuffer + kAckHeaderSize + kAckPayloadSize, kAeadTagSize);
+    return err == 0 ? kAckFrameSize : 0;
+  }
+
+  // TX side: authenticates and decrypts an ACK frame.
+  bool openAck(const uint8_t *inputBuffer, size_t bufferLength,
+               AckTelemetry &ackOut) {
+    FrameView<AckHeaderSchema> header(inputBuffer, bufferLength);
+    if (!ready_ || !header.valid() || bufferLength != kAckFrameSize ||
+        header.get<kAckKindField>() != kAckFrameKind) {
+      return false;
+    }
+    uint32_t sequence = header.get<kAckSequenceField>();
+    uint8_t vehicle = header.get<kAckVehicleField>();
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kAckFrameKind, vehicle, sequence, nonce);
+
+    uint8_t payload[kAckPayloadSize];
+    int err = mbedtls_ccm_auth_decrypt(
+        &ccmCtx_, kAckPayloadSize, nonce, sizeof(nonce), inputBuffer,
+        kAckHeaderSize, inputBuffer + kAckHeaderSize, payload,
+        inputBuffer + kAckHeaderSize + kAckPayloadSize, kAeadTagSize);
+    if (err != 0) {
+      return false;
+    }
+
+    FrameView<AckPayloadSchema> plain(payload, sizeof(payload));
+    ackOut.sequence = sequence;
+    ackOut.vehicle = vehicle;
+    ackOut.rssiDbm = plain.get<kAckRssiField>();
+    ackOut.snrQuarterDb = plain.get<kAckSnrField>();
+    ackOut.leftMotor = plain.get<kAckLeftMotorField>();
+    ackOut.rightMotor = plain.get<kAckRightMotorField>();
+    ackOut.status = plain.get<kAckStatusField>();
+    return true;
+  }
+
+  // TX side: writes a kHeartbeatFrameSize-byte heartbeat carrying sequence
+  // and periodMs (rounded up to kHeartbeatPeriodUnitMs, capped at 255
+  // units). The sequence comes from the command counter, epoch included, so
+  // the nonce never repeats. Returns the number of bytes written, 0 on
+  // failure.
+  size_t sealHeartbeat(uint32_t sequence, uint16_t periodMs,
+                       uint8_t *outputBuffer, size_t bufferLength) {
+    if (!ready_ || !outputBuffer || bufferLength < kHeartbeatFrameSize) {
+      return 0;
+    }
+    FrameWriter<HeartbeatHeaderSchema> header(outputBuffer,
+                                              kHeartbeatHeaderSize);
+    header.set<kHeartbeatKindField>(kHeartbeatFrameKind);
+    header.set<kHeartbeatSequenceField>(static_cast<uint16_t>(sequence));
+
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kHeartbeatFrameKind, kBroadcastVehicle, sequence, nonce);
+    uint32_t units =
+        (periodMs + kHeartbeatPeriodUnitMs - 1) / kHeartbeatPeriodUnitMs;
+    uint8_t payload[kHeartbeatPayloadSize] = {
+        static_cast<uint8_t>(units > 255 ? 255 : units)};
+    int err = mbedtls_ccm_encrypt_and_tag(
+        &ccmCtx_, kHeartbeatPayloadSize, nonce, sizeof(nonce), outputBuffer,
+        kHeartbeatHeaderSize, payload, outputBuffer + kHeartbeatHeaderSize,
+        outputBuffer + kHeartbeatHeaderSize + kHeartbeatPayloadSize,
+        kAeadTagSize);
+    return err == 0 ? kHeartbeatFrameSize : 0;
+  }
+
+  // RX side: authenticates a heartbeat. referenceSequence is the highest
+  // sequence accepted so far (ReplayWindow::highest()); the restored
+  // sequence still has to pass the replay window. Until the first command
+  // frame primes the window, heartbeats from a long-running TX may not
+  // authenticate, which only delays arming the dead-man timer.
+  bool openHeartbeat(const uint8_t *inputBuffer, size_t bufferLength,
+                     uint32_t referenceSequence, uint32_t &sequenceOut,
+                     uint16_t &periodMsOut) {
+    FrameView<HeartbeatHeaderSchema> header(inputBuffer, bufferLength);
+    if (!ready_ || !header.valid() || bufferLength != kHeartbeatFrameSize ||
+        header.get<kHeartbeatKindField>() != kHeartbeatFrameKind) {
+      return false;
+    }
+    uint32_t sequence = expandSequence(
+        header.get<kHeartbeatSequenceField>(), referenceSequence);
+    uint8_t nonce[kAeadNonceSize];
+    buildNonce(kHeartbeatFrameKind, kBroadcastVehicle, sequence, nonce);
+
+    uint8_t payload[kHeartbeatPayloadSize];
+    int err = mbedtls_ccm_auth_decrypt(
+        &ccmCtx_, kHeartbeatPayloadSize, nonce, sizeof(nonce), inputBuffer,
+        kHeartbeatHeaderSize, inputBuffer + kHeartbeatHeaderSize, payload,
+        inputBuffer + kHeartbeatHeaderSize + kHeartbeatPayloadSize,
+        kAeadTagSize);
+    if (err != 0) {
+      return false;
+    }
+    sequenceOut = sequence;
+    periodMsOut = static_cast<uint16_t>(payload[0] * kHeartbeatPeriodUnitMs);
+    return true;
+  }
+
+  // Decodes either wire format: 16-byte v1 (AES-CBC + CRC-32) or 15-byte v2
+  // (AES-CCM). The two are told apart by length and version byte. Only v2
+  // frames carry a timestamp and an address (v1 reports kBroadcastVehicle);
+  // frameOut.version tells the caller which it got.
+  bool decodeAny(const uint8_t *inputBuffer, size_t bufferLength,
+                 ControlFrame &frameOut, uint16_t *txTimeMsOut = nullptr,
+                 uint8_t *vehicleOut = nullptr) {
+    if (bufferLength == kFrameSize) {
+      if (vehicleOut) {
+        *vehicleOut = kBroadcastVehicle;
+      }
+      return decrypt(inputBuffer, bufferLength, frameOut);
+    }
+    return openV2(inputBuffer, bufferLength, frameOut, txTimeMsOut,
+                  vehicleOut);
+  }
+
+ private:
+  static void buildNonce(uint8_t version, uint8_t vehicle, uint32_t sequence,
+                         uint8_t *nonce) {
+    static_assert(sizeof(kAeadNonceSalt) + 2 + 4 == kAeadNonceSize,
+                  "nonce layout out of sync with kAeadNonceSize");
+    memcpy(nonce, kAeadNonceSalt, sizeof(kAeadNonceSalt));
+    nonce[sizeof(kAeadNonceSalt)] = version;
+    nonce[sizeof(kAeadNonceSalt) + 1] = vehicle;
+    Scalar<uint32_t>::store(nonce + sizeof(kAeadNonceSalt) + 2, sequence);
+  }
+
+  mbedtls_aes_context encCtx_;
+  mbedtls_aes_context decCtx_;
+  mbedtls_ccm_context ccmCtx_;
+  bool ready_ = false;
+};
+
+// Anti-replay filter over 32-bit sequence numbers (RFC 6479 style). Keeps
+// the highest accepted sequence plus a 64-bit bitmap of the 64 sequences at
+// and below it, so late or retransmitted frames inside the window are
+// accepted exactly once. Every check is O(1); sequence wrap-around is handled
+// with serial-number arithmetic. A sequence from a later epoch
+// (sequenceEpoch()) opens a new TX session: it restarts the window, so a
+// rebooted TX gets through at once, and anything older than the session's
+// first frame is rejected from then on.
+class ReplayWindow {
+ public:
+  static constexpr uint32_t kWindowSize = 64;
+
+  void reset() {
+    highest_ = 0;
+    bitmap_ = 0;
+    sessionAge_ = 0;
+    primed_ = false;
+  }
+
+  // True if sequence is new and not older than the window. Does not record it,
+  // so callers can check before spending time on decryption.
+  bool check(uint32_t sequence) const {
+    if (!primed_) {
+      return true;
+    }
+    int32_t delta = static_cast<int32_t>(sequence - highest_);
+    if (delta > 0) {
+      return true;
+    }
+    uint32_t offset = static_cast<uint32_t>(-static_cast<int64_t>(delta));
+    if (offset >= kWindowSize || offset > sessionAge_) {
+      return false;
+    }
+    return (bitmap_ & (1ull << offset)) == 0;
+  }
+
+  // Records an authenticated sequence number.
+  void update(uint32_t sequence) {
+    int32_t delta = static_cast<int32_t>(sequence - highest_);
+    if (!primed_ || (delta > 0 && sequenceEpoch(sequence) != epoch())) {
+      primed_ = true;
+      highest_ = sequence;
+      bitmap_ = 1;
+      sessionAge_ = 0;
+      return;
+    }
+    if (delta > 0) {
+      bitmap_ = delta >= static_cast<int32_t>(kWindowSize)
+                    ? 1
+                    : (bitmap_ << delta) | 1;
+      highest_ = sequence;
+      if (sessionAge_ < kWindowSize) {
+        sessionAge_ += static_cast<uint32_t>(delta);
+      }
+      return;
+    }
+    uint32_t offset = static_cast<uint32_t>(-static_cast<int64_t>(delta));
+    if (offset < kWindowSize) {
+      bitmap_ |= 1ull << offset;
+    }
+  }
+
+  bool accept(uint32_t sequence) {
+    if (!check(sequence)) {
+      return false;
+    }
+    update(sequence);
+    return true;
+  }
+
+  uint32_t highest() const { return highest_; }
+  // Epoch of the current TX session.
+  uint16_t epoch() const { return sequenceEpoch(highest_); }
+
+ private:
+  uint32_t highest_ = 0;
+  uint64_t bitmap_ = 0;
+  // How far highest_ is past the session's first frame (saturates once it
+  // reaches the window); nothing further back belongs to this session.
+  uint32_t sessionAge_ = 0;
+  bool primed_ = false;
+};
+
+// RX-side command time-to-live. TX and RX clocks are not synchronised, so
+// the filter estimates the offset as the smallest (rxTime - txTime) seen so
+// far, i.e. clock offset plus the fastest delivery, and measures each
+// frame's age against it. The estimate relaxes by 1 ms every 10 s to follow
+// crystal drift. It is re-anchored only when the TX session changes, i.e. on
+// the first frame of a new epoch (the TX clock restarts when it reboots);
+// drops alone never re-anchor it, so a burst of delayed frames stays
+// dropped. Within a session a frame can lower the estimate by at most
+// maxAgeMs, so one held back long enough for its 16-bit age to wrap is
+// dropped rather than taken for a faster path. Pass frames through the
+// ReplayWindow first, so only the current session reaches the filter.
+// Timestamps are 16-bit, so bounds must stay well below 32 s.
+// STOP frames bypass the filter: a late stop is still safe, and frames from
+// StopFrameCache carry the time they were built rather than sent.
+class StalenessFilter {
+ public:
+  static constexpr uint32_t kRelaxIntervalMs = 10000;
+
+  explicit StalenessFilter(uint16_t maxAgeMs = 1000) : maxAgeMs_(maxAgeMs) {}
+
+  void setMaxAgeMs(uint16_t maxAgeMs) { maxAgeMs_ = maxAgeMs; }
+  uint16_t maxAgeMs() const { return maxAgeMs_; }
+
+  // True if the frame stamped txTimeMs is fresh enough to apply at rxNowMs.
+  // epoch is sequenceEpoch() of the frame's sequence.
+  bool accept(uint16_t epoch, uint16_t txTimeMs, uint32_t rxNowMs) {
+    uint16_t delta = static_cast<uint16_t>(rxNowMs - txTimeMs);
+    if (primed_ && rxNowMs - lastRelaxMs_ >= kRelaxIntervalMs) {
+      lastRelaxMs_ = rxNowMs;
+      ++minDelta_;
+    }
+    if (!primed_ || epoch != epoch_) {
+      primed_ = true;
+      epoch_ = epoch;
+      minDelta_ = delta;
+      lastRelaxMs_ = rxNowMs;
+    }
+
+    lastAgeMs_ = static_cast<uint16_t>(delta - minDelta_);
+    int16_t skew = static_cast<int16_t>(lastAgeMs_);
+    if (skew < 0 && -skew <= maxAgeMs_) {
+      // A faster delivery than any so far lowers the estimate.
+      minDelta_ = delta;
+      lastAgeMs_ = 0;
+    }
+    if (lastAgeMs_ <= maxAgeMs_) {
+      return true;
+    }
+    // Anything further back is a frame held for 32 s or more, whose age
+    // has wrapped; it must not move the estimate.
+    ++dropped_;
+    return false;
+  }
+
+  uint32_t dropped() const { return dropped_; }
+  uint16_t lastAgeMs() const { return lastAgeMs_; }
+  // Estimated (RX clock - TX clock) in ms, modulo 2^16, including the
+  // minimum delivery latency.
+  uint16_t offsetMs() const { return minDelta_; }
+
+ private:
+  uint16_t maxAgeMs_;
+  uint16_t minDelta_ = 0;
+  uint16_t lastAgeMs_ = 0;
+  uint32_t lastRelaxMs_ = 0;
+  uint32_t dropped_ = 0;
+  uint16_t epoch_ = 0;
+  bool primed_ = false;
+};
+
+// RX-side dead-man switch. Every authenticated, accepted frame feeds it;
+// heartbeats also carry the TX period, and the timeout becomes
+// kMissedHeartbeats periods. When it expires the RX must ramp to Stop and
+// cancel any trajectory, and stay stopped until the next command frame.
+class DeadManTimer {
+ public:
+  static constexpr uint8_t kMissedHeartbeats = 3;
+
+  explicit DeadManTimer(uint32_t timeoutMs = 3000) : timeoutMs_(timeoutMs) {}
+
+  void feed(uint32_t nowMs) {
+    lastFeedMs_ = nowMs;
+    armed_ = true;
+  }
+
+  void feedHeartbeat(uint32_t nowMs, uint16_t periodMs) {
+    if (periodMs != 0) {
+      timeoutMs_ = static_cast<uint32_t>(periodMs) * kMissedHeartbeats;
+    }
+    feed(nowMs);
+  }
+
+  // True on the first call after the timeout has run out; the timer then
+  // disarms until the next feed, so each silence stops the motors once.
+  bool expired(uint32_t nowMs) {
+    if (!armed_ || nowMs - lastFeedMs_ < timeoutMs_) {
+      return false;
+    }
+    armed_ = false;
+    ++trips_;
+    return true;
+  }
+
+  uint32_t timeoutMs() const { return timeoutMs_; }
+  uint32_t trips() const { return trips_; }
+
+ private:
+  uint32_t timeoutMs_;
+  uint32_t lastFeedMs_ = 0;
+  uint32_t trips_ = 0;
+  bool armed_ = false;
+};
+
+// TX-side ring of pre-encrypted STOP frames for the next kDepth sequence
+// numbers, so a safety stop is a FIFO write with no CRC or AES work. Slot
+// (sequence % kDepth) holds that sequence; each time the counter advances
+// exactly one slot goes stale and refill() rebuilds it during idle time.
+class StopFrameCache {
+ public:
+  static constexpr size_t kDepth = 4;
+
+  // Builds every slot that does not already hold its sequence in
+  // [nextSequence, nextSequence + kDepth) for the given wire version.
+  // Returns the number of frames built.
+  size_t refill(CipherSession &cipher, uint8_t version, uint32_t nextSequence,
+                uint16_t nowMs) {
+    size_t built = 0;
+    for (size_t i = 0; i < kDepth; ++i) {
+      uint32_t sequence = nextSequence + static_cast<uint32_t>(i);
+      Entry &entry = entries_[sequence % kDepth];
+      if (entry.length != 0 && entry.sequence == sequence &&
+          entry.version == version) {
+        continue;
+      }
+      ControlFrame frame;
+      initFrame(frame, Command::Stop, 0, 0, sequence);
+      size_t length = 0;
+      if (version == kProtocolVersionAead) {
+        length = cipher.sealV2(frame, kBroadcastVehicle, nowMs, entry.data,
+                               sizeof(entry.data));
+      } else if (cipher.encrypt(frame, entry.data, sizeof(entry.data))) {
+        length = kFrameSize;
+      }
+      entry.sequence = sequence;
+      entry.version = version;
+      entry.length = static_cast<uint8_t>(length);
+      built += length != 0;
+    }
+    return built;
+  }
+
+  // Encrypted STOP for sequence, or nullptr if that slot is not ready.
+  const uint8_t *lookup(uint32_t sequence, size_t &length) const {
+    const Entry &entry = entries_[sequence % kDepth];
+    if (entry.length == 0 || entry.sequence != sequence) {
+      return nullptr;
+    }
+    length = entry.length;
+    return entry.data;
+  }
+
+  void invalidate() {
+    for (Entry &entry : entries_) {
+      entry.length = 0;
+    }
+  }
+
+ private:
+  struct Entry {
+    uint32_t sequence = 0;
+    uint8_t version = 0;
+    uint8_t length = 0;
+    uint8_t data[kFrameSize];
+  };
+
+  Entry entries_[kDepth];
+};
+
 inline Command commandFromFrame(const ControlFrame &frame) {
   switch (frame.command) {
     case static_cast<uint8_t>(Command::Stop): return Command::Stop;
@@ -141,8 +1206,47 @@ inline Command commandFromFrame(const ControlFrame &frame) {
     case static_cast<uint8_t>(Command::Left): return Command::Left;
     case static_cast<uint8_t>(Command::Right): return Command::Right;
     case static_cast<uint8_t>(Command::SetSpeed): return Command::SetSpeed;
+    case static_cast<uint8_t>(Command::Trajectory): return Command::Trajectory;
+    case static_cast<uint8_t>(Command::Drive): return Command::Drive;
+    case static_cast<uint8_t>(Command::SetRadio): return Command::SetRadio;
     default: return Command::Stop;
   }
 }
 
+// RX-side playback of a TrajectoryPacket. Segments run back to back from
+// the time start() is called; any regular command frame should cancel() the
+// trajectory, and when the last segment ends the caller ramps to Stop.
+class TrajectoryPlayer {
+ public:
+  void start(const TrajectoryPacket &packet, uint32_t nowMs) {
+    count_ = packet.header.leftSpeed;
+    if (count_ > kMaxTrajectorySegments) {
+      count_ = 0;
+    }
+    memcpy(segments_, packet.segments, sizeof(segments_));
+    index_ = 0;
+    segmentStartMs_ = nowMs;
+  }
+
+  void cancel() { count_ = 0; }
+
+  bool active() const { return index_ < count_; }
+
+  // Segment to apply at nowMs, or nullptr once the trajectory has finished.
+  const TrajectorySegment *current(uint32_t nowMs) {
+    while (index_ < count_ &&
+           nowMs - segmentStartMs_ >= segments_[index_].durationMs) {
+      segmentStartMs_ += segments_[index_].durationMs;
+      ++index_;
+    }
+    return index_ < count_ ? &segments_[index_] : nullptr;
+  }
+
+ private:
+  TrajectorySegment segments_[kMaxTrajectorySegments];
+  size_t count_ = 0;
+  size_t index_ = 0;
+  uint32_t segmentStartMs_ = 0;
+};
+
 }  // namespace TankControl
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Platform.h"
+
+// CRC-32 (IEEE 802.3, reflected, poly 0xEDB88320) engines. All of them
+// produce byte-for-byte identical results; the one behind crc32() is picked
+// at compile time with TANK_CRC32_ENGINE.
+#define TANK_CRC32_ENGINE_BITWISE 0
+#define TANK_CRC32_ENGINE_SLICE4 1
+#define TANK_CRC32_ENGINE_SLICE8 2
+#define TANK_CRC32_ENGINE_ROM 3
+
+#ifndef TANK_CRC32_ENGINE
+#if defined(ESP32)
+#define TANK_CRC32_ENGINE TANK_CRC32_ENGINE_ROM
+#else
+#define TANK_CRC32_ENGINE TANK_CRC32_ENGINE_SLICE8
+#endif
+#endif
+
+#if defined(ESP32)
+#include <esp_rom_crc.h>
+#elif TANK_CRC32_ENGINE == TANK_CRC32_ENGINE_ROM
+#error "TANK_CRC32_ENGINE_ROM requires the ESP32 ROM CRC routines."
+#endif
+
+namespace TankControl {
+
+constexpr uint32_t kCrc32Polynomial = 0xEDB88320u;
+
+// Reference implementation: one shift/mask step per bit. Portable and
+// table-free, used as the fallback engine and as the oracle for the others.
+inline uint32_t crc32Bitwise(const uint8_t *data, size_t length) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < length; ++i) {
+    crc ^= static_cast<uint32_t>(data[i]);
+    for (uint8_t j = 0; j < 8; ++j) {
+      uint32_t mask = -(crc & 1u);
+      crc = (crc >> 1) ^ (kCrc32Polynomial & mask);
+    }
+  }
+  return ~crc;
+}
+
+// Slicing tables: entries[0] is the classic byte-wise table, entries[k]
+// advances a byte through k further zero bytes. Built once on first use
+// (8 KiB of RAM) so no flash-resident literal table is needed.
+struct Crc32Tables {
+  uint32_t entries[8][256];
+
+  Crc32Tables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (uint8_t j = 0; j < 8; ++j) {
+        uint32_t mask = -(crc & 1u);
+        crc = (crc >> 1) ^ (kCrc32Polynomial & mask);
+      }
+      entries[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+      for (uint8_t k = 1; k < 8; ++k) {
+        uint32_t prev = entries[k - 1][i];
+        entries[k][i] = (prev >> 8) ^ entries[0][prev & 0xFFu];
+      }
+    }
+  }
+};
+
+inline const Crc32Tables &crc32Tables() {
+  static const Crc32Tables tables;
+  return tables;
+}
+
+inline uint32_t loadLe32(const uint8_t *data) {
+  return static_cast<uint32_t>(data[0]) |
+         (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) |
+         (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline uint32_t crc32Slice4(const uint8_t *data, size_t length) {
+  const Crc32Tables &t = crc32Tables();
+  uint32_t crc = 0xFFFFFFFFu;
+  while (length >= 4) {
+    crc ^= loadLe32(data);
+    crc = t.entries[3][crc & 0xFFu] ^ t.entries[2][(crc >> 8) & 0xFFu] ^
+          t.entries[1][(crc >> 16) & 0xFFu] ^ t.entries[0][crc >> 24];
+    data += 4;
+    length -= 4;
+  }
+  while (length--) {
+    crc = (crc >> 8) ^ t.entries[0][(crc ^ *data++) & 0xFFu];
+  }
+  return ~crc;
+}
+
+inline uint32_t crc32Slice8(const uint8_t *data, size_t length) {
+  const Crc32Tables &t = crc32Tables();
+  uint32_t crc = 0xFFFFFFFFu;
+  while (length >= 8) {
+    uint32_t lo = crc ^ loadLe32(data);
+    uint32_t hi = loadLe32(data + 4);
+    crc = t.entries[7][lo & 0xFFu] ^ t.entries[6][(lo >> 8) & 0xFFu] ^
+          t.entries[5][(lo >> 16) & 0xFFu] ^ t.entries[4][lo >> 24] ^
+          t.entries[3][hi & 0xFFu] ^ t.entries[2][(hi >> 8) & 0xFFu] ^
+          t.entries[1][(hi >> 16) & 0xFFu] ^ t.entries[0][hi >> 24];
+    data += 8;
+    length -= 8;
+  }
+  while (length--) {
+    crc = (crc >> 8) ^ t.entries[0][(crc ^ *data++) & 0xFFu];
+  }
+  return ~crc;
+}
+
+#if defined(ESP32)
+// The mask ROM ships a table-driven CRC-32; a seed of 0 yields the standard
+// IEEE value (the routine applies the pre/post inversion itself).
+inline uint32_t crc32Rom(const uint8_t *data, size_t length) {
+  return esp_rom_crc32_le(0, data, static_cast<uint32_t>(length));
+}
+#endif
+
+inline uint32_t crc32(const uint8_t *data, size_t length) {
+#if TANK_CRC32_ENGINE == TANK_CRC32_ENGINE_ROM
+  return crc32Rom(data, length);
+#elif TANK_CRC32_ENGINE == TANK_CRC32_ENGINE_SLICE8
+  return crc32Slice8(data, length);
+#elif TANK_CRC32_ENGINE == TANK_CRC32_ENGINE_SLICE4
+  return crc32Slice4(data, length);
+#else
+  return crc32Bitwise(data, length);
+#endif
+}
+
+}  // namespace TankControl
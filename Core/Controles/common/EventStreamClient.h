@@ -0,0 +1,182 @@
+#pragma once
+
+// Firmware only: needs the Arduino WiFiClient. Not part of the host build.
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "HttpResponse.h"
+#include "ServerSentEvents.h"
+
+// Keeps one Server-Sent Events stream open to the status server so commands
+// arrive as soon as they are posted instead of at the next poll. service()
+// never waits on the stream: it drains what has arrived and stops at each
+// complete event. The server pings the stream, so silence longer than
+// kStaleMs means the connection is dead even if TCP has not noticed; the
+// stream is then dropped and reopened with exponential backoff.
+//
+// Opening the stream is the one step that blocks: connect() waits up to
+// the connect timeout, so keep it well under any deadline the calling task
+// must meet between services. Give url an IP address; a host name adds a
+// DNS lookup the timeout does not bound.
+
+namespace TankControl {
+
+template <size_t DataCapacity>
+class EventStreamClient {
+ public:
+  static constexpr uint32_t kStaleMs = 2000;
+  static constexpr uint32_t kMinBackoffMs = 1000;
+  static constexpr uint32_t kMaxBackoffMs = 30000;
+  static constexpr size_t kMaxBytesPerService = 1024;
+  static constexpr uint32_t kDefaultConnectTimeoutMs = 250;
+
+  bool begin(const char *url,
+             uint32_t connectTimeoutMs = kDefaultConnectTimeoutMs) {
+    connectTimeoutMs_ = connectTimeoutMs;
+    valid_ = url_.parse(url);
+    return valid_;
+  }
+
+  // Closes the stream, e.g. after WiFi loss; the next service() reopens
+  // it straight away.
+  void stop() {
+    if (client_.connected()) {
+      ++drops_;
+    }
+    client_.stop();
+    open_ = false;
+    retryMs_ = 0;
+    backoffMs_ = kMinBackoffMs;
+  }
+
+  // Connects or reconnects when due, then reads until an event is complete
+  // or nothing more has arrived. Returns true with the event in events();
+  // call again until it returns false.
+  bool service() {
+    uint32_t now = millis();
+    if (!open_) {
+      if (!valid_ || now - lastAttemptMs_ < retryMs_) {
+        return false;
+      }
+      open(now);
+      return false;
+    }
+    if (!client_.connected() && client_.available() == 0) {
+      drop(now);
+      return false;
+    }
+    size_t budget = kMaxBytesPerService;
+    while (budget-- > 0 && client_.available() > 0) {
+      int byte = client_.read();
+      if (byte < 0) {
+        break;
+      }
+      lastActivityMs_ = now;
+      ++bytes_;
+      if (!http_.feed(static_cast<uint8_t>(byte))) {
+        if (http_.failed() || http_.done()) {
+          drop(now);
+          return false;
+        }
+        if (http_.inBody() && !streaming_) {
+          if (http_.status() != 200) {
+            drop(now);
+            return false;
+          }
+          streaming_ = true;
+          backoffMs_ = kMinBackoffMs;
+        }
+        continue;
+      }
+      if (events_.feed(static_cast<uint8_t>(byte))) {
+        if (events_.truncated()) {
+          ++truncated_;
+          continue;
+        }
+        return true;
+      }
+    }
+    if (now - lastActivityMs_ >= kStaleMs) {
+      drop(now);
+    }
+    return false;
+  }
+
+  // Stream open, answered 200, and heard from within kStaleMs.
+  bool live() const {
+    return open_ && streaming_ && millis() - lastActivityMs_ < kStaleMs;
+  }
+
+  // millis() when the last byte (event or ping) arrived.
+  uint32_t lastActivityMs() const { return lastActivityMs_; }
+  const SseParser<DataCapacity> &events() const { return events_; }
+  SseParser<DataCapacity> &events() { return events_; }
+  uint32_t connects() const { return connects_; }
+  uint32_t drops() const { return drops_; }
+  uint32_t failedConnects() const { return failedConnects_; }
+  uint32_t truncated() const { return truncated_; }
+  uint32_t bytes() const { return bytes_; }
+
+ private:
+  void open(uint32_t now) {
+    lastAttemptMs_ = now;
+    client_.stop();
+    char head[HttpUrl::kMaxHostLength + HttpUrl::kMaxPathLength + 96];
+    size_t length = url_.formatGet(head, sizeof(head),
+                                   "Accept: text/event-stream\r\n"
+                                   "Cache-Control: no-cache\r\n");
+    if (!client_.connect(url_.host, url_.port,
+                         static_cast<int32_t>(connectTimeoutMs_)) ||
+        client_.write(reinterpret_cast<const uint8_t *>(head), length) !=
+            length) {
+      client_.stop();
+      ++failedConnects_;
+      backOff();
+      return;
+    }
+    client_.setNoDelay(true);
+    http_.reset();
+    events_.reset();
+    streaming_ = false;
+    open_ = true;
+    lastActivityMs_ = millis();
+    ++connects_;
+  }
+
+  void drop(uint32_t now) {
+    client_.stop();
+    open_ = false;
+    ++drops_;
+    lastAttemptMs_ = now;
+    backOff();
+  }
+
+  // Waits backoffMs_ before the next attempt and doubles it for the one
+  // after; a stream that reaches 200 resets it.
+  void backOff() {
+    retryMs_ = backoffMs_;
+    backoffMs_ =
+        backoffMs_ * 2 > kMaxBackoffMs ? kMaxBackoffMs : backoffMs_ * 2;
+  }
+
+  WiFiClient client_;
+  HttpUrl url_;
+  HttpResponseParser http_;
+  SseParser<DataCapacity> events_;
+  uint32_t connectTimeoutMs_ = kDefaultConnectTimeoutMs;
+  bool valid_ = false;
+  bool open_ = false;
+  bool streaming_ = false;
+  uint32_t lastAttemptMs_ = 0;
+  uint32_t lastActivityMs_ = 0;
+  uint32_t retryMs_ = 0;
+  uint32_t backoffMs_ = kMinBackoffMs;
+  uint32_t connects_ = 0;
+  uint32_t drops_ = 0;
+  uint32_t failedConnects_ = 0;
+  uint32_t truncated_ = 0;
+  uint32_t bytes_ = 0;
+};
+
+}  // namespace TankControl
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Airtime.h"
+
+// TDMA command schedule for a controller driving several vehicles on one
+// channel. Time is cut into equal slots, one per vehicle in turn; a slot is
+// long enough for the largest frame plus its ACK, so a vehicle's command
+// never waits more than one full round of slots.
+
+namespace TankControl {
+
+// Slot sizing and the bounds that follow from it, for reporting.
+struct FleetTiming {
+  uint8_t vehicles;
+  uint32_t frameAirUs;             // largest frame a slot must carry
+  uint32_t slotUs;                 // frame + ACK window + guard, budget-paced
+  uint32_t roundUs;                // vehicles * slotUs
+  uint32_t worstLatencyUs;         // command posted to frame fully on air
+  uint32_t perVehicleRateMilliHz;  // commands per vehicle per 1000 s
+  uint8_t maxVehiclesForTarget;    // largest fleet within the latency target
+};
+
+// ackWindowUs is the ACK airtime plus turnaround. The slot is stretched if
+// the airtime budget would not cover one frame per slot.
+inline FleetTiming fleetTiming(const RadioProfile &profile, uint8_t vehicles,
+                               size_t maxFrameBytes, uint32_t ackWindowUs,
+                               uint32_t guardUs, uint32_t budgetUsPerSecond,
+                               uint32_t latencyTargetUs) {
+  FleetTiming timing = {};
+  timing.vehicles = vehicles ? vehicles : 1;
+  timing.frameAirUs = timeOnAirUs(profile, maxFrameBytes);
+  uint32_t slotUs = timing.frameAirUs + ackWindowUs + guardUs;
+  if (budgetUsPerSecond > 0) {
+    uint64_t pacedUs =
+        static_cast<uint64_t>(timing.frameAirUs) * 1000000 / budgetUsPerSecond;
+    if (pacedUs > slotUs) {
+      slotUs = static_cast<uint32_t>(pacedUs);
+    }
+  }
+  timing.slotUs = slotUs;
+  timing.roundUs = slotUs * timing.vehicles;
+  // Worst case: the command lands just after its slot's last usable start,
+  // waits a full round and then spends one frame on air.
+  timing.worstLatencyUs = timing.roundUs + timing.frameAirUs;
+  timing.perVehicleRateMilliHz =
+      static_cast<uint32_t>(1000000000ull / timing.roundUs);
+  uint32_t fit = latencyTargetUs > timing.frameAirUs
+                     ? (latencyTargetUs - timing.frameAirUs) / slotUs
+                     : 0;
+  timing.maxVehiclesForTarget = static_cast<uint8_t>(fit > 255 ? 255 : fit);
+  return timing;
+}
+
+// Tracks whose slot it is. Vehicles are numbered 1..vehicles. Slot
+// boundaries advance from the first call by whole slots, so micros()
+// wrap-around is harmless as long as it is polled more often than every
+// 71 minutes.
+class TdmaSchedule {
+ public:
+  void configure(uint8_t vehicles, uint32_t slotUs) {
+    vehicles_ = vehicles ? vehicles : 1;
+    slotUs_ = slotUs;
+    started_ = false;
+  }
+
+  uint8_t vehicles() const { return vehicles_; }
+  uint32_t slotUs() const { return slotUs_; }
+
+  // Owner of the slot containing nowUs; intoSlotUs receives the offset.
+  uint8_t ownerAt(uint32_t nowUs, uint32_t &intoSlotUs) {
+    advance(nowUs);
+    intoSlotUs = nowUs - slotStartUs_;
+    return owner_;
+  }
+
+  // Grants the current slot once to a transmission of busyUs (frame plus
+  // ACK window) if it still fits before the slot ends. Returns the owner,
+  // or kBroadcastVehicle (0) when nothing may start now.
+  uint8_t claim(uint32_t nowUs, uint32_t busyUs) {
+    uint32_t intoSlotUs = 0;
+    uint8_t owner = ownerAt(nowUs, intoSlotUs);
+    if (claimed_ || intoSlotUs + busyUs > slotUs_) {
+      return 0;
+    }
+    return owner;
+  }
+
+  // Marks the current slot used; call after the owner's frame went out.
+  void markClaimed() { claimed_ = true; }
+
+ private:
+  void advance(uint32_t nowUs) {
+    if (!started_) {
+      started_ = true;
+      slotStartUs_ = nowUs;
+      owner_ = 1;
+      claimed_ = false;
+      return;
+    }
+    uint32_t slots = (nowUs - slotStartUs_) / slotUs_;
+    if (slots == 0) {
+      return;
+    }
+    slotStartUs_ += slots * slotUs_;
+    uint32_t index = (owner_ - 1 + slots % vehicles_) % vehicles_;
+    owner_ = static_cast<uint8_t>(index + 1);
+    claimed_ = false;
+  }
+
+  uint8_t vehicles_ = 1;
+  uint32_t slotUs_ = 1;
+  uint32_t slotStartUs_ = 0;
+  uint8_t owner_ = 1;
+  bool claimed_ = false;
+  bool started_ = false;
+};
+
+}  // namespace TankControl
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Plain-socket HTTP/1.x helpers for the controller's connections to the
+// status server. HttpResponseParser is an incremental response parser.
+// It is fed one byte at a time straight from the socket and reports which
+// bytes belong to the body. That is enough to find where a response ends on
+// a kept-alive connection: Content-Length, chunked transfer coding, or
+// (without either) connection close. Only the headers that matter for
+// framing and reuse are looked at; long header lines are truncated, not
+// rejected.
+
+namespace TankControl {
+
+// "http://host[:port]/path" split for a raw socket client. https and
+// over-long hosts or paths are rejected.
+struct HttpUrl {
+  static constexpr size_t kMaxHostLength = 63;
+  static constexpr size_t kMaxPathLength = 63;
+
+  char host[kMaxHostLength + 1] = {};
+  char path[kMaxPathLength + 1] = {};
+  uint16_t port = 80;
+
+  bool parse(const char *url) {
+    const char *prefix = "http://";
+    for (; *prefix != '\0'; ++prefix, ++url) {
+      if (*url != *prefix) {
+        return false;
+      }
+    }
+    size_t hostLength = 0;
+    while (*url != '\0' && *url != ':' && *url != '/') {
+      if (hostLength == kMaxHostLength) {
+        return false;
+      }
+      host[hostLength++] = *url++;
+    }
+    host[hostLength] = '\0';
+    port = 80;
+    if (*url == ':') {
+      uint32_t value = 0;
+      for (++url; *url >= '0' && *url <= '9'; ++url) {
+        value = value * 10 + static_cast<uint32_t>(*url - '0');
+      }
+      if (value == 0 || value > 65535) {
+        return false;
+      }
+      port = static_cast<uint16_t>(value);
+    }
+    size_t pathLength = 0;
+    if (*url != '/') {
+      path[pathLength++] = '/';
+    }
+    while (*url != '\0' && pathLength < kMaxPathLength) {
+      path[pathLength++] = *url++;
+    }
+    path[pathLength] = '\0';
+    return hostLength > 0 && *url == '\0';
+  }
+
+  // Writes a GET request head for this URL, with "?query" appended when
+  // query is not empty; extraHeaders is zero or more complete
+  // "Name: value\r\n" lines. Returns its length, or 0 if it does not fit.
+  size_t formatGet(char *out, size_t capacity, const char *extraHeaders,
+                   const char *query = nullptr) const {
+    bool hasQuery = query != nullptr && query[0] != '\0';
+    int length = snprintf(out, capacity,
+                          "GET %s%s%s HTTP/1.1\r\nHost: %s\r\n%s\r\n", path,
+                          hasQuery ? "?" : "", hasQuery ? query : "", host,
+                          extraHeaders);
+    if (length <= 0 || static_cast<size_t>(length) >= capacity) {
+      return 0;
+    }
+    return static_cast<size_t>(length);
+  }
+};
+
+class HttpResponseParser {
+ public:
+  static constexpr size_t kMaxLineLength = 96;
+
+  enum class State : uint8_t {
+    StatusLine,
+    Headers,
+    Body,
+    ChunkSize,
+    ChunkData,
+    ChunkDataEnd,
+    Trailers,
+    Done,
+    Error
+  };
+
+  void reset() {
+    state_ = State::StatusLine;
+    lineLength_ = 0;
+    status_ = 0;
+    http11_ = false;
+    connectionClose_ = false;
+    connectionKeepAlive_ = false;
+    chunked_ = false;
+    contentLength_ = -1;
+    remaining_ = 0;
+    bodyBytes_ = 0;
+    heldMs_ = 0;
+  }
+
+  // Feeds one byte. Returns true if it is body data (chunk framing is
+  // stripped).
+  bool feed(uint8_t byte) {
+    switch (state_) {
+      case State::Body:
+        ++bodyBytes_;
+        if (contentLength_ >= 0 && --remaining_ == 0) {
+          state_ = State::Done;
+        }
+        return true;
+      case State::ChunkData:
+        ++bodyBytes_;
+        if (--remaining_ == 0) {
+          state_ = State::ChunkDataEnd;
+        }
+        return true;
+      case State::Done:
+      case State::Error:
+        return false;
+      default:
+        break;
+    }
+    if (byte == '\r') {
+      return false;
+    }
+    if (byte != '\n') {
+      if (lineLength_ < kMaxLineLength) {
+        line_[lineLength_++] = static_cast<char>(byte);
+      }
+      return false;
+    }
+    line_[lineLength_] = '\0';
+    size_t length = lineLength_;
+    lineLength_ = 0;
+    endLine(length);
+    return false;
+  }
+
+  // The server closed the connection. A body framed by connection close is
+  // complete now; anything else was cut short.
+  void closed() {
+    if (state_ == State::Body && contentLength_ < 0) {
+      state_ = State::Done;
+    } else if (state_ != State::Done) {
+      state_ = State::Error;
+    }
+  }
+
+  State state() const { return state_; }
+  bool done() const { return state_ == State::Done; }
+  bool failed() const { return state_ == State::Error; }
+  bool inBody() const {
+    return state_ >= State::Body && state_ <= State::Trailers;
+  }
+  int status() const { return status_; }
+  bool chunked() const { return chunked_; }
+  int32_t contentLength() const { return contentLength_; }
+  uint32_t bodyBytes() const { return bodyBytes_; }
+  // X-Held-Ms: how long the Orion API held a long-poll request before
+  // answering, so client timings can leave it out.
+  uint32_t heldMs() const { return heldMs_; }
+
+  // Whether the connection may carry the next request once this response
+  // is done. HTTP/1.1 defaults to persistent, HTTP/1.0 to close; a body
+  // framed by close can never be followed by another response.
+  bool keepAlive() const {
+    if (connectionClose_ || (!chunked_ && contentLength_ < 0)) {
+      return false;
+    }
+    return http11_ || connectionKeepAlive_;
+  }
+
+ private:
+  void endLine(size_t length) {
+    switch (state_) {
+      case State::StatusLine:
+        parseStatusLine(length);
+        return;
+      case State::Headers:
+        if (length == 0) {
+          beginBody();
+        } else {
+          parseHeader();
+        }
+        return;
+      case State::ChunkSize:
+        parseChunkSize();
+        return;
+      case State::ChunkDataEnd:
+        state_ = length == 0 ? State::ChunkSize : State::Error;
+        return;
+      case State::Trailers:
+        if (length == 0) {
+          state_ = State::Done;
+        }
+        return;
+      default:
+        return;
+    }
+  }
+
+  // "HTTP/1.1 200 OK"
+  void parseStatusLine(size_t length) {
+    if (length < 12 || !startsWith(line_, "HTTP/1.") || line_[8] != ' ') {
+      state_ = State::Error;
+      return;
+    }
+    http11_ = line_[7] != '0';
+    int status = 0;
+    for (size_t i = 9; i < 12; ++i) {
+      if (line_[i] < '0' || line_[i] > '9') {
+        state_ = State::Error;
+        return;
+      }
+      status = status * 10 + (line_[i] - '0');
+    }
+    status_ = status;
+    state_ = State::Headers;
+  }
+
+  void parseHeader() {
+    const char *value = nullptr;
+    if ((value = headerValue("content-length")) != nullptr) {
+      contentLength_ = static_cast<int32_t>(parseDecimal(value));
+    } else if ((value = headerValue("x-held-ms")) != nullptr) {
+      heldMs_ = parseDecimal(value);
+    } else if ((value = headerValue("transfer-encoding")) != nullptr) {
+      chunked_ = containsToken(value, "chunked");
+    } else if ((value = headerValue("connection")) != nullptr) {
+      connectionClose_ = containsToken(value, "close");
+      connectionKeepAlive_ = containsToken(value, "keep-alive");
+    }
+  }
+
+  void beginBody() {
+    // 1xx, 204 and 304 carry no body whatever the headers say.
+    if (status_ < 200 || status_ == 204 || status_ == 304) {
+      state_ = State::Done;
+      contentLength_ = 0;
+      chunked_ = false;
+      return;
+    }
+    if (chunked_) {
+      contentLength_ = -1;
+      state_ = State::ChunkSize;
+    } else if (contentLength_ == 0) {
+      state_ = State::Done;
+    } else {
+      remaining_ = contentLength_;
+      state_ = State::Body;
+    }
+  }
+
+  void parseChunkSize() {
+    uint32_t size = 0;
+    size_t digits = 0;
+    for (const char *c = line_; *c != '\0' && *c != ';' && *c != ' '; ++c) {
+      int nibble = hexValue(*c);
+      if (nibble < 0 || ++digits > 7) {
+        state_ = State::Error;
+        return;
+      }
+      size = (size << 4) | static_cast<uint32_t>(nibble);
+    }
+    if (digits == 0) {
+      state_ = State::Error;
+    } else if (size == 0) {
+      state_ = State::Trailers;
+    } else {
+      remaining_ = static_cast<int32_t>(size);
+      state_ = State::ChunkData;
+    }
+  }
+
+  // Value of the header in line_ if its name is `name` (lower case),
+  // with leading blanks skipped; nullptr otherwise.
+  const char *headerValue(const char *name) const {
+    const char *c = line_;
+    for (; *name != '\0'; ++name, ++c) {
+      if (lower(*c) != *name) {
+        return nullptr;
+      }
+    }
+    if (*c != ':') {
+      return nullptr;
+    }
+    ++c;
+    while (*c == ' ' || *c == '\t') {
+      ++c;
+    }
+    return c;
+  }
+
+  // Case-insensitive search for token in a comma-separated header value.
+  static bool containsToken(const char *value, const char *token) {
+    for (const char *start = value; *start != '\0'; ++start) {
+      const char *c = start;
+      const char *t = token;
+      while (*t != '\0' && lower(*c) == *t) {
+        ++c;
+        ++t;
+      }
+      if (*t == '\0') {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static uint32_t parseDecimal(const char *text) {
+    uint32_t value = 0;
+    for (; *text >= '0' && *text <= '9'; ++text) {
+      value = value * 10 + static_cast<uint32_t>(*text - '0');
+    }
+    return value;
+  }
+
+  static bool startsWith(const char *text, const char *prefix) {
+    for (; *prefix != '\0'; ++prefix, ++text) {
+      if (*text != *prefix) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+  }
+
+  static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    c = lower(c);
+    if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    }
+    return -1;
+  }
+
+  State state_ = State::StatusLine;
+  char line_[kMaxLineLength + 1] = {};
+  size_t lineLength_ = 0;
+  int status_ = 0;
+  bool http11_ = false;
+  bool connectionClose_ = false;
+  bool connectionKeepAlive_ = false;
+  bool chunked_ = false;
+  int32_t contentLength_ = -1;
+  int32_t remaining_ = 0;
+  uint32_t bodyBytes_ = 0;
+  uint32_t heldMs_ = 0;
+};
+
+}  // namespace TankControl
@@ -0,0 +1,11 @@
+#pragma once
+
+// The protocol headers build both inside the Arduino firmware and in the
+// host-native benchmark environment (env:native), which has no Arduino core.
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#endif
@@ -0,0 +1,176 @@
+#pragma once
+
+// Firmware only: needs the Arduino SPI driver and an SX127x on the bus. Not
+// part of the host build.
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// SPI access to the SX127x for the per-packet hot path. The sandeepmistry
+// driver moves FIFO data one register transaction per byte, and its read()
+// also polls RegRxNbBytes for every byte, so a 64-byte packet costs 64 to
+// 128 chip-select cycles. The FIFO register auto-increments its address, so
+// RadioAccess moves a whole packet in one transaction. It also runs CAD for
+// listen-before-talk, which the driver does not expose without taking over
+// DIO0.
+//
+// DIO0 belongs to the sketch, not the driver: the driver's handler reads
+// the IRQ flags and FIFO pointers over SPI inside the interrupt, where it
+// can cut into a transaction a task has open on the same bus. The sketch's
+// interrupt only wakes its radio task, which calls takeIrqFlags() and
+// beginRead() instead. Modes and configuration stay with the driver.
+
+namespace TankControl {
+
+class RadioAccess {
+ public:
+  // SX1276 SPI clock limit (datasheet, 10 MHz). The T-Beam routes the radio
+  // through the GPIO matrix, which is good for more than that.
+  static constexpr uint32_t kMaxSpiHz = 10000000;
+  static constexpr size_t kMaxPacketSize = 255;
+
+  static constexpr uint8_t kIrqTxDone = 0x08;
+  static constexpr uint8_t kIrqPayloadCrcError = 0x20;
+  static constexpr uint8_t kIrqRxDone = 0x40;
+
+  enum class CadResult : uint8_t { Pending, Clear, Busy };
+
+  void begin(SPIClass &spi, uint8_t csPin, uint32_t spiHz = kMaxSpiHz) {
+    spi_ = &spi;
+    csPin_ = csPin;
+    settings_ = SPISettings(spiHz, MSBFIRST, SPI_MODE0);
+  }
+
+  // Call between LoRa.beginPacket(), which rewinds the FIFO pointer and
+  // zeroes the payload length, and endPacket().
+  void loadPacket(const uint8_t *payload, size_t length) {
+    if (length > kMaxPacketSize) {
+      length = kMaxPacketSize;
+    }
+    writeBurst(kRegFifo, payload, length);
+    writeRegister(kRegPayloadLength, static_cast<uint8_t>(length));
+  }
+
+  // Routes TxDone to DIO0 for the following LoRa.endPacket(true), which
+  // only does so itself when a driver callback is set. LoRa.receive()
+  // routes RxDone back.
+  void mapDio0TxDone() { writeRegister(kRegDioMapping1, kDio0TxDone); }
+
+  // Reads the IRQ flags after a DIO0 edge and clears them, all but the
+  // CAD flags, which pollCad() owns.
+  uint8_t takeIrqFlags() {
+    uint8_t flags = readRegister(kRegIrqFlags);
+    uint8_t handled = flags & ~(kIrqCadDone | kIrqCadDetected);
+    if (handled != 0) {
+      writeRegister(kRegIrqFlags, handled);
+    }
+    return flags;
+  }
+
+  // After RxDone (explicit header mode): points the FIFO at the packet just
+  // received and returns its length, as the driver's handler would.
+  size_t beginRead() {
+    writeRegister(kRegFifoAddrPtr, readRegister(kRegFifoRxCurrentAddr));
+    return readRegister(kRegRxNbBytes);
+  }
+
+  // Call once the packet has been located, by beginRead() or the driver's
+  // parsePacket(), so the FIFO points at it. Reads up to capacity bytes of
+  // it and returns how many were read.
+  size_t readPacket(uint8_t *out, size_t capacity, size_t packetLength) {
+    size_t length = packetLength < capacity ? packetLength : capacity;
+    readBurst(kRegFifo, out, length);
+    return length;
+  }
+
+  // Starts channel activity detection. The radio must be in standby
+  // (LoRa.idle()) and returns there by itself when CAD is done. DIO0 stays
+  // mapped for RxDone/TxDone, which do not fire in CAD mode, so no DIO0
+  // interrupt is involved; poll with pollCad().
+  void startCad() {
+    writeRegister(kRegIrqFlags, kIrqCadDone | kIrqCadDetected);
+    writeRegister(kRegOpMode, kModeLongRange | kModeCad);
+  }
+
+  CadResult pollCad() {
+    uint8_t flags = readRegister(kRegIrqFlags);
+    if ((flags & kIrqCadDone) == 0) {
+      return CadResult::Pending;
+    }
+    writeRegister(kRegIrqFlags, kIrqCadDone | kIrqCadDetected);
+    return (flags & kIrqCadDetected) ? CadResult::Busy : CadResult::Clear;
+  }
+
+  // Blocking CAD for simple senders. A CAD that has not finished within
+  // timeoutUs counts as clear and the radio is put back in standby.
+  bool channelClear(uint32_t timeoutUs) {
+    startCad();
+    uint32_t startUs = micros();
+    for (;;) {
+      CadResult result = pollCad();
+      if (result != CadResult::Pending) {
+        return result == CadResult::Clear;
+      }
+      if (micros() - startUs >= timeoutUs) {
+        writeRegister(kRegOpMode, kModeLongRange | kModeStandby);
+        return true;
+      }
+    }
+  }
+
+  uint8_t readRegister(uint8_t reg) {
+    uint8_t value = 0;
+    readBurst(reg, &value, 1);
+    return value;
+  }
+
+  void writeRegister(uint8_t reg, uint8_t value) { writeBurst(reg, &value, 1); }
+
+  // One transaction: address byte, then length data bytes.
+  void writeBurst(uint8_t reg, const uint8_t *data, size_t length) {
+    select();
+    spi_->transfer(static_cast<uint8_t>(reg | kWriteFlag));
+    spi_->writeBytes(data, length);
+    deselect();
+  }
+
+  void readBurst(uint8_t reg, uint8_t *data, size_t length) {
+    select();
+    spi_->transfer(static_cast<uint8_t>(reg & ~kWriteFlag));
+    spi_->transferBytes(nullptr, data, length);
+    deselect();
+  }
+
+ private:
+  static constexpr uint8_t kWriteFlag = 0x80;
+  static constexpr uint8_t kRegFifo = 0x00;
+  static constexpr uint8_t kRegOpMode = 0x01;
+  static constexpr uint8_t kRegFifoAddrPtr = 0x0D;
+  static constexpr uint8_t kRegFifoRxCurrentAddr = 0x10;
+  static constexpr uint8_t kRegIrqFlags = 0x12;
+  static constexpr uint8_t kRegRxNbBytes = 0x13;
+  static constexpr uint8_t kRegPayloadLength = 0x22;
+  static constexpr uint8_t kRegDioMapping1 = 0x40;
+  static constexpr uint8_t kDio0TxDone = 0x40;
+  static constexpr uint8_t kModeLongRange = 0x80;
+  static constexpr uint8_t kModeStandby = 0x01;
+  static constexpr uint8_t kModeCad = 0x07;
+  static constexpr uint8_t kIrqCadDetected = 0x01;
+  static constexpr uint8_t kIrqCadDone = 0x04;
+
+  void select() {
+    spi_->beginTransaction(settings_);
+    digitalWrite(csPin_, LOW);
+  }
+
+  void deselect() {
+    digitalWrite(csPin_, HIGH);
+    spi_->endTransaction();
+  }
+
+  SPIClass *spi_ = &SPI;
+  uint8_t csPin_ = 0;
+  SPISettings settings_;
+};
+
+}  // namespace TankControl
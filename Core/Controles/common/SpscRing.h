@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <atomic>
+
+namespace TankControl {
+
+// Lock-free single-producer/single-consumer ring. Exactly one task calls
+// push() and exactly one calls pop(); neither ever blocks or takes a lock,
+// so a stalled producer cannot delay the consumer. Indices run freely and
+// are masked on access, which is why Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SpscRing capacity must be a power of two");
+
+ public:
+  // Producer side. Returns false (and drops item) when the ring is full.
+  bool push(const T &item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    slots_[head & (Capacity - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the ring is empty.
+  bool pop(T &item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots_[tail & (Capacity - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called concurrently with push()/pop().
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+ private:
+  T slots_[Capacity];
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+}  // namespace TankControl
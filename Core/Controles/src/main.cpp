@@ -2,11 +2,22 @@
 #include <SPI.h>
 #include <LoRa.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <esp_system.h>
+#include <Preferences.h>
 #include <WebServer.h>
 #include <ArduinoJson.h>
 #include "../common/ControlProtocol.h"
+#include "../common/SpscRing.h"
+#include "../common/Airtime.h"
+#include "../common/LinkStats.h"
+#include "../common/AdaptiveRate.h"
+#include "../common/LinkBench.h"
+#include "../common/Fleet.h"
+#include "../common/RadioAccess.h"
+#include "../common/ListenBeforeTalk.h"
+#include "../common/StatusClient.h"
+#include "../common/EventStreamClient.h"
+#include "../common/StatusBinary.h"
 #include "LoRaBoards.h"
 
 // ---------- Board selection: LilyGO T-Beam (ESP32) ----------
@@ -23,11 +34,87 @@
 #ifndef CONFIG_RADIO_BW
 #define CONFIG_RADIO_BW 125.0
 #endif
+#ifndef CONFIG_RADIO_SF
+#define CONFIG_RADIO_SF 7
+#endif
+// SPI clock for the radio, driver and burst FIFO path alike. 10 MHz is the
+// SX1276 limit; lower it only for long or noisy wiring.
+#ifndef CONFIG_RADIO_SPI_HZ
+#define CONFIG_RADIO_SPI_HZ 10000000
+#endif
+// Airtime the scheduler may spend per second (token bucket). Lower it to
+// respect a regional duty-cycle limit, e.g. 10 for 1 %.
+#ifndef CONFIG_AIRTIME_BUDGET_MS
+#define CONFIG_AIRTIME_BUDGET_MS 500
+#endif
+// Listen-before-talk: a CAD before every non-STOP frame, with randomised
+// backoff while the channel is busy.
+#ifndef CONFIG_LBT_ENABLE
+#define CONFIG_LBT_ENABLE 1
+#endif
+// Adaptive data rate: step SF (and, with CONFIG_ADR_ALLOW_BW, bandwidth)
+// from measured ACK margin and loss. Needs an RX that implements SetRadio;
+// older RX firmware treats the unknown command as STOP.
+#ifndef CONFIG_ADR_ENABLE
+#define CONFIG_ADR_ENABLE 0
+#endif
+#ifndef CONFIG_ADR_MAX_LOSS_PERCENT
+#define CONFIG_ADR_MAX_LOSS_PERCENT 10
+#endif
+#ifndef CONFIG_ADR_TARGET_MARGIN_DB
+#define CONFIG_ADR_TARGET_MARGIN_DB 10
+#endif
+#ifndef CONFIG_ADR_ALLOW_BW
+#define CONFIG_ADR_ALLOW_BW 0
+#endif
+// 1 = AES-256-CBC + CRC-32 (16 bytes), 2 = AES-256-CCM + address + timestamp (15 bytes).
+#ifndef CONFIG_PROTOCOL_VERSION
+#define CONFIG_PROTOCOL_VERSION 1
+#endif
+// Vehicles driven by this controller, numbered 1..CONFIG_FLEET_SIZE. Above 1
+// commands go out in TDMA slots; addressing needs protocol v2.
+#ifndef CONFIG_FLEET_SIZE
+#define CONFIG_FLEET_SIZE 1
+#endif
+// Worst-case command latency the fleet capacity report is checked against.
+#ifndef CONFIG_FLEET_LATENCY_TARGET_MS
+#define CONFIG_FLEET_LATENCY_TARGET_MS 1500
+#endif
+// Heartbeat period while the vehicles may be moving; 0 disables. The RX
+// dead-man timer stops the motors after three missed periods.
+#ifndef CONFIG_HEARTBEAT_MS
+#define CONFIG_HEARTBEAT_MS 1000
+#endif
+#if CONFIG_HEARTBEAT_MS > 2550
+#error "CONFIG_HEARTBEAT_MS must be at most 2550 (the frame carries 10 ms units)"
+#endif
+// MODE 2 push channel: hold a Server-Sent Events stream (GET /events) so a
+// posted command goes out at once; polling drops to a slower fallback while
+// the stream is live.
+#ifndef CONFIG_PUSH_ENABLE
+#define CONFIG_PUSH_ENABLE 1
+#endif
+// MODE 2 polls GET /status.bin (fixed binary records, no JSON parse) and
+// falls back to GET /status if the server does not have it; 0 polls JSON.
+#ifndef CONFIG_STATUS_BINARY
+#define CONFIG_STATUS_BINARY 1
+#endif
+#if CONFIG_FLEET_SIZE < 1 || CONFIG_FLEET_SIZE > 32
+#error "CONFIG_FLEET_SIZE must be 1..32"
+#endif
+#if CONFIG_FLEET_SIZE > 1 && CONFIG_PROTOCOL_VERSION != 2
+#error "Fleet addressing needs CONFIG_PROTOCOL_VERSION 2"
+#endif
+#if CONFIG_FLEET_SIZE > 1 && CONFIG_ADR_ENABLE
+#error "Adaptive data rate supports a single vehicle"
+#endif
 
 // ========================================
 // MODO DE OPERACIÓN
 // 1 = AP + Web UI
 // 2 = Cliente WiFi + GET a servidor
+// 3 = Banco de enlace, emisor (barrido de perfiles)
+// 4 = Banco de enlace, receptor
 // ========================================
 const uint8_t MODE = 2;
 
@@ -35,11 +122,175 @@ const char *kStaSsid = "UPBWiFi";
 const char *kStaPassword = "";
 
 const char *kServerUrl = "http://3.230.70.191:4040/status";
+const char *kServerBinaryUrl = "http://3.230.70.191:4040/status.bin";
+// One kept-alive connection to the status server instead of a new
+// HTTPClient (and TCP handshake) per poll.
+TankControl::StatusClient statusClient;
+const char *kEventsUrl = "http://3.230.70.191:4040/events";
+
+TankControl::CipherSession cipher;
+TankControl::RadioAccess radioAccess;
+TankControl::StopFrameCache stopCache;
+
+#if CONFIG_PROTOCOL_VERSION == 2
+const uint8_t kWireVersion = TankControl::kProtocolVersionAead;
+const size_t kWireFrameSize = TankControl::kAeadFrameSize;
+// v2 trajectories only carry the segments in use.
+constexpr size_t wireTrajectorySize(size_t segments) { return TankControl::aeadTrajectoryFrameSize(segments); }
+#else
+const uint8_t kWireVersion = TankControl::kProtocolVersion;
+const size_t kWireFrameSize = TankControl::kFrameSize;
+constexpr size_t wireTrajectorySize(size_t) { return TankControl::kTrajectoryPacketSize; }
+#endif
+// Largest frame on air; sizes ACK timeouts, TDMA slots and LBT bounds.
+const size_t kWireTrajectorySize = wireTrajectorySize(TankControl::kMaxTrajectorySegments);
+
+const TankControl::RadioProfile kBaseRadioProfile = {CONFIG_RADIO_SF, static_cast<uint32_t>(CONFIG_RADIO_BW * 1000),
+                                                     5, 8, true, false};
+TankControl::RadioProfile radioProfile = kBaseRadioProfile;
+TankControl::AirtimeBudget airtimeBudget(CONFIG_AIRTIME_BUDGET_MS * 1000UL);
+
+const uint8_t kFleetSize = CONFIG_FLEET_SIZE;
+const uint32_t kTdmaGuardUs = 10000;
+TankControl::TdmaSchedule tdma;
+TankControl::FleetTiming fleetLimits;
+
+// Safety-stop timing, trigger (sendStopCommand) to the radio entering TX.
+struct StopLatencyStats
+{
+  uint32_t lastUs = 0;
+  uint32_t maxUs = 0;
+  uint32_t cacheHits = 0;
+  uint32_t cacheMisses = 0;
+};
+StopLatencyStats stopLatency;
+
+// Network task -> radio task commands. Stop requests carry the time the
+// network side decided to stop, so stopLatency covers the ring hop too.
+enum class RadioRequestKind : uint8_t
+{
+  Frame,
+  Trajectory,
+  Stop
+};
+
+struct RadioRequest
+{
+  RadioRequestKind kind;
+  uint8_t vehicle;
+  uint8_t command;
+  uint8_t leftSpeed;
+  uint8_t rightSpeed;
+  uint8_t segmentCount;
+  TankControl::TrajectorySegment segments[TankControl::kMaxTrajectorySegments];
+  uint32_t postedUs;
+  // Set when a push event produced the request; pushRxUs is when the event
+  // arrived, for the event-to-radio latency.
+  bool fromPush;
+  uint32_t pushRxUs;
+};
+
+struct PipelineStats
+{
+  uint32_t handled = 0;
+  uint32_t postFailed = 0;
+  uint32_t deadlineStops = 0;
+  uint32_t coalesced = 0;
+  uint32_t budgetDeferred = 0;
+  uint32_t lastQueueUs = 0;
+  uint32_t maxQueueUs = 0;
+  uint64_t totalQueueUs = 0;
+  // Push event arrival to the frame being handed to the TX queue.
+  uint32_t pushDispatched = 0;
+  uint32_t lastPushUs = 0;
+  uint32_t maxPushUs = 0;
+  uint64_t totalPushUs = 0;
+};
+
+// Share of wall time a task spends outside its wait, over 1 s windows. For
+// the network task this includes time blocked inside WiFi/HTTP calls.
+struct TaskLoad
+{
+  uint32_t windowStartUs = 0;
+  uint32_t busyUs = 0;
+  uint8_t percent = 0;
+
+  void add(uint32_t us)
+  {
+    busyUs += us;
+    uint32_t now = micros();
+    uint32_t windowUs = now - windowStartUs;
+    if (windowUs >= 1000000)
+    {
+      percent = static_cast<uint8_t>(min<uint32_t>(100, static_cast<uint64_t>(busyUs) * 100 / windowUs));
+      windowStartUs = now;
+      busyUs = 0;
+    }
+  }
+};
+
+const uint32_t kNetworkStopDeadlineMs = 1500;
+const uint32_t kRadioTaskPeriodMs = 2;
+const uint32_t kNetworkTaskPeriodMs = 5;
+const uint32_t kTaskStackSize = 8192;
+
+TankControl::SpscRing<RadioRequest, 16> radioRing;
+TaskHandle_t radioTaskHandle = nullptr;
+std::atomic<uint32_t> networkOkMs{0};
+bool radioStopped = true;
+PipelineStats pipelineStats;
+TaskLoad radioLoad;
+TaskLoad networkLoad;
+
+// Every sequence carries the TX epoch in its upper 16 bits
+// (TankControl::sequenceEpoch()). The epoch in use is recorded in NVS before
+// its first sequence goes on air, so after a reboot the TX resumes with a
+// fresh epoch and never repeats a nonce.
+Preferences epochStore;
+uint32_t sequenceCounter = 0;
+uint16_t epochStored = 0;
+
+// Opens this boot's epoch. False if NVS cannot be read or every epoch has
+// been used; the key must then be replaced and NVS erased.
+bool beginSequence()
+{
+  if (!epochStore.begin("tankctl", false))
+    return false;
+  epochStored = epochStore.getUShort("epoch", 0);
+  sequenceCounter = TankControl::firstSequence(static_cast<uint16_t>(epochStored + 1));
+  return TankControl::sequenceEpoch(sequenceCounter) != 0;
+}
+
+// Takes the next sequence number, recording a new epoch first. False when
+// no sequence can be issued without risking a repeat.
+bool takeSequence(uint32_t &sequence)
+{
+  uint16_t epoch = TankControl::sequenceEpoch(sequenceCounter);
+  if (epoch == 0 || (epoch != epochStored && epochStore.putUShort("epoch", epoch) != sizeof(uint16_t)))
+  {
+    Serial.println("No sequence number: epoch exhausted or not saved");
+    return false;
+  }
+  epochStored = epoch;
+  sequence = sequenceCounter++;
+  return true;
+}
 
-uint8_t sequenceCounter = 0;
-uint8_t currentLeftSpeed = 0;
-uint8_t currentRightSpeed = 0;
-String lastState = "STOP";
+// Network-side view of what each vehicle was last told (index vehicle - 1).
+struct VehicleCommandState
+{
+  uint8_t leftSpeed = 0;
+  uint8_t rightSpeed = 0;
+  String lastState = "STOP";
+  uint32_t lastTrajectoryId = 0;
+  bool lastCommandWasStop = true;
+};
+VehicleCommandState vehicleStates[kFleetSize];
+
+VehicleCommandState &vehicleState(uint8_t vehicle)
+{
+  return vehicleStates[vehicle - 1];
+}
 
 unsigned long lastGetTime = 0;
 const long getInterval = 500;
@@ -47,7 +298,6 @@ unsigned long lastWifiCheck = 0;
 const long wifiCheckInterval = 5000;
 
 bool wasConnected = false;
-bool lastCommandWasStop = true;
 
 WebServer server(80);
 
@@ -97,6 +347,17 @@ const char indexPage[] PROGMEM = R"rawliteral(
     </label>
     <button data-cmd="speed" id="speedBtn">Set Speeds</button>
   </div>
+  <div class="speeds">
+    <label>Left drive
+      <input id="leftDrive" type="range" min="-100" max="100" value="0">
+      <span id="leftDriveValue">0</span>
+    </label>
+    <label>Right drive
+      <input id="rightDrive" type="range" min="-100" max="100" value="0">
+      <span id="rightDriveValue">0</span>
+    </label>
+    <button id="centerBtn">Center</button>
+  </div>
   <div id="status">State: IDLE</div>
   <footer>Connect to the TankController Wi-Fi network (password: tank12345).</footer>
   <script>
@@ -135,6 +396,48 @@ const char indexPage[] PROGMEM = R"rawliteral(
       btn.addEventListener('click', () => sendCommand(btn.dataset.cmd));
     });
     document.getElementById('speedBtn').addEventListener('click', () => sendCommand('speed'));
+
+    // Drive sliders stream signed wheel velocities at up to 20 Hz.
+    const leftDrive = document.getElementById('leftDrive');
+    const rightDrive = document.getElementById('rightDrive');
+    let driveTimer = null;
+    let drivePending = false;
+
+    async function sendDrive() {
+      document.getElementById('leftDriveValue').textContent = leftDrive.value;
+      document.getElementById('rightDriveValue').textContent = rightDrive.value;
+      const params = new URLSearchParams({ left: leftDrive.value, right: rightDrive.value });
+      try {
+        const res = await fetch('/drive', { method: 'POST', body: params });
+        if (!res.ok) throw new Error('HTTP ' + res.status);
+        const data = await res.json();
+        statusEl.textContent = `State: ${data.state}`;
+      } catch (err) {
+        statusEl.textContent = 'State: ERROR - ' + err.message;
+      }
+    }
+
+    function scheduleDrive() {
+      if (driveTimer) {
+        drivePending = true;
+        return;
+      }
+      sendDrive();
+      driveTimer = setTimeout(() => {
+        driveTimer = null;
+        if (drivePending) {
+          drivePending = false;
+          scheduleDrive();
+        }
+      }, 50);
+    }
+    leftDrive.addEventListener('input', scheduleDrive);
+    rightDrive.addEventListener('input', scheduleDrive);
+    document.getElementById('centerBtn').addEventListener('click', () => {
+      leftDrive.value = 0;
+      rightDrive.value = 0;
+      scheduleDrive();
+    });
   </script>
 </body>
 </html>
@@ -155,333 +458,2588 @@ TankControl::Command parseCommand(const String &action)
   return TankControl::Command::Stop;
 }
 
-bool sendLoRaFrame(TankControl::Command cmd, uint8_t leftSpeed, uint8_t rightSpeed)
+// Maps the API's command names (case-insensitive) to protocol commands.
+TankControl::Command commandFromName(const char *name)
 {
-  TankControl::ControlFrame frame;
-  TankControl::initFrame(frame, cmd, leftSpeed, rightSpeed, sequenceCounter++);
+  if (strcasecmp(name, "FORWARD") == 0)
+    return TankControl::Command::Forward;
+  if (strcasecmp(name, "BACKWARD") == 0)
+    return TankControl::Command::Backward;
+  if (strcasecmp(name, "LEFT") == 0)
+    return TankControl::Command::Left;
+  if (strcasecmp(name, "RIGHT") == 0)
+    return TankControl::Command::Right;
+  if (strcasecmp(name, "TRAJECTORY") == 0)
+    return TankControl::Command::Trajectory;
+  if (strcasecmp(name, "DRIVE") == 0)
+    return TankControl::Command::Drive;
+  return TankControl::Command::Stop;
+}
 
-  uint8_t encrypted[TankControl::kFrameSize];
-  if (!TankControl::encryptFrame(frame, encrypted, sizeof(encrypted)))
+// The same commands as sent in GET /status.bin; anything else is Stop, as
+// an unknown name is.
+TankControl::Command commandFromCode(uint8_t code)
+{
+  switch (static_cast<TankControl::Command>(code))
   {
-    Serial.println("Encrypt failed");
-    return false;
+  case TankControl::Command::Forward:
+  case TankControl::Command::Backward:
+  case TankControl::Command::Left:
+  case TankControl::Command::Right:
+  case TankControl::Command::Trajectory:
+  case TankControl::Command::Drive:
+    return static_cast<TankControl::Command>(code);
+  default:
+    return TankControl::Command::Stop;
   }
+}
 
-  LoRa.idle();
-  LoRa.beginPacket();
-  LoRa.write(encrypted, sizeof(encrypted));
-  bool ok = LoRa.endPacket() == 1;
-  LoRa.receive();
-
-  if (ok)
+const char *commandName(TankControl::Command command)
+{
+  switch (command)
   {
-    Serial.print("TX -> cmd=");
-    Serial.print(static_cast<int>(frame.command));
-    Serial.print(" seq=");
-    Serial.print(frame.sequence);
-    Serial.print(" left=");
-    Serial.print(frame.leftSpeed);
-    Serial.print(" right=");
-    Serial.println(frame.rightSpeed);
+  case TankControl::Command::Forward:
+    return "FORWARD";
+  case TankControl::Command::Backward:
+    return "BACKWARD";
+  case TankControl::Command::Left:
+    return "LEFT";
+  case TankControl::Command::Right:
+    return "RIGHT";
+  case TankControl::Command::Trajectory:
+    return "TRAJECTORY";
+  case TankControl::Command::Drive:
+    return "DRIVE";
+  default:
+    return "STOP";
   }
-  else
+}
+
+// ========================================
+// ASYNC TX QUEUE
+// Frames are queued and sent with endPacket(true); DIO0 TxDone wakes
+// radioTask, which reads the IRQ flags (serviceRadioIrq) and lets
+// serviceTxQueue() complete the frame and start the next one, so nothing
+// busy-waits for time on air.
+// A STOP aborts any non-STOP frame in the air and flushes pending ones.
+// Every other frame first listens: a CAD, polled from serviceTxQueue(), and
+// a random backoff while the channel is busy.
+// ========================================
+struct TxRequest;
+typedef void (*TxDoneCallback)(const TxRequest &request, bool ok, uint32_t airUs);
+
+struct TxRequest
+{
+  uint8_t data[TankControl::kTrajectoryPacketSize];
+  uint8_t length;
+  uint8_t command;
+  uint32_t sequence;
+  bool expectsAck;
+  TxDoneCallback done;
+};
+
+struct TxQueueStats
+{
+  uint32_t depth = 0;
+  uint32_t maxDepth = 0;
+  uint32_t sent = 0;
+  uint32_t failed = 0;
+  uint32_t dropped = 0;
+  uint32_t preempted = 0;
+  uint32_t lastTxDoneUs = 0;
+  uint32_t maxTxDoneUs = 0;
+};
+
+const size_t kTxQueueDepth = 8;
+const uint32_t kTxTimeoutUs = 4000000;
+
+TxRequest txQueue[kTxQueueDepth];
+size_t txQueueHead = 0;
+TxRequest txActive;
+bool txBusy = false;
+uint32_t txActiveStartUs = 0;
+bool txDoneFlag = false;
+uint32_t txDoneAtUs = 0;
+TxQueueStats txStats;
+
+// Listen-before-talk state of txActive: txListening while it waits for the
+// channel, either in a CAD started at txCadStartUs or, with txBackingOff,
+// until txBackoffUntilUs.
+const bool kLbtEnabled = CONFIG_LBT_ENABLE;
+TankControl::ListenBeforeTalk lbt;
+bool txListening = false;
+bool txBackingOff = false;
+uint32_t txCadStartUs = 0;
+uint32_t txBackoffUntilUs = 0;
+uint32_t lbtCadTimeouts = 0;
+
+// ACK back-channel. Every frame that finishes transmitting is tracked until
+// the RX acknowledges it or kAckTimeoutUs passes. After each frame the
+// scheduler keeps the channel quiet for one ACK window so the reply is not
+// lost to our own next transmission (the radio is half duplex).
+struct LinkTelemetry
+{
+  uint32_t lastAckMs = 0;
+  uint32_t badFrames = 0;
+  int16_t remoteRssiDbm = 0;
+  int8_t remoteSnrQuarterDb = 0;
+  int16_t localRssiDbm = 0;
+  float localSnrDb = 0;
+  int8_t leftMotor = 0;
+  int8_t rightMotor = 0;
+  uint8_t status = 0;
+};
+
+const uint32_t kAckTimeoutUs = 1500000;
+const uint32_t kAckTurnaroundUs = 30000;
+
+TankControl::AckTracker ackTracker(kAckTimeoutUs);
+LinkTelemetry linkTelemetry;
+bool rxPendingFlag = false;
+int rxPendingSize = 0;
+uint32_t rxAtUs = 0;
+bool awaitingAck = false;
+uint32_t awaitingAckSequence = 0;
+uint32_t ackWaitStartUs = 0;
+
+// DIO0 (TxDone or RxDone). The LoRa driver's own handler does SPI inside
+// the interrupt, which can land in the middle of a radioTask transaction on
+// the same bus; this one only notes the time and wakes radioTask, so all
+// radio SPI runs on that one task.
+volatile bool dio0Pending = false;
+volatile uint32_t dio0AtUs = 0;
+
+void IRAM_ATTR onRadioDio0()
+{
+  dio0AtUs = micros();
+  dio0Pending = true;
+  if (radioTaskHandle)
   {
-    Serial.println("LoRa TX failed");
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(radioTaskHandle, &woken);
+    if (woken)
+      portYIELD_FROM_ISR();
   }
-  return ok;
 }
 
-void sendStopCommand()
+// Turns a DIO0 edge into txDoneFlag or rxPendingFlag, doing the register
+// work the driver's handler would. Runs first on every radioTask pass, so
+// the FIFO is located before anything else touches the radio.
+void serviceRadioIrq()
 {
-  if (lastCommandWasStop && currentLeftSpeed == 0 && currentRightSpeed == 0)
-  {
+  if (!dio0Pending)
     return;
+  dio0Pending = false;
+  uint32_t atUs = dio0AtUs;
+  uint8_t flags = radioAccess.takeIrqFlags();
+  if (flags & TankControl::RadioAccess::kIrqRxDone)
+  {
+    if (flags & TankControl::RadioAccess::kIrqPayloadCrcError)
+    {
+      linkTelemetry.badFrames++;
+    }
+    else
+    {
+      rxPendingSize = static_cast<int>(radioAccess.beginRead());
+      rxAtUs = atUs;
+      rxPendingFlag = true;
+    }
   }
-
-  currentLeftSpeed = 0;
-  currentRightSpeed = 0;
-  lastState = "STOP";
-  lastCommandWasStop = true;
-
-  if (sendLoRaFrame(TankControl::Command::Stop, 0, 0))
+  if (flags & TankControl::RadioAccess::kIrqTxDone)
   {
-    Serial.println("SAFETY STOP sent: No connection or server error.");
+    txDoneAtUs = atUs;
+    txDoneFlag = true;
   }
 }
 
-void sendSpectrumTestBurst()
+void logTxDone(const TxRequest &request, bool ok, uint32_t airUs)
 {
-  static constexpr size_t kBurstSize = 192;
-  uint8_t payload[kBurstSize];
-  for (size_t i = 0; i < kBurstSize; ++i)
+  if (ok)
+  {
+    Serial.printf("TX -> cmd=%u seq=%u len=%u air=%uus\n", request.command,
+                  static_cast<unsigned>(request.sequence), request.length,
+                  static_cast<unsigned>(airUs));
+  }
+  else
   {
-    payload[i] = static_cast<uint8_t>(random(0, 256));
+    Serial.printf("LoRa TX failed (cmd=%u seq=%u)\n", request.command,
+                  static_cast<unsigned>(request.sequence));
   }
+}
 
-  Serial.println("Sending LoRa spectrum test burst...");
-  LoRa.idle();
-  LoRa.beginPacket();
-  LoRa.write(payload, sizeof(payload));
-  if (LoRa.endPacket() == 1)
+void finishActiveTx(bool ok, uint32_t airUs)
+{
+  txBusy = false;
+  txListening = false;
+  txBackingOff = false;
+  if (ok)
   {
-    Serial.print("Burst length: ");
-    Serial.println(sizeof(payload));
+    txStats.sent++;
+    txStats.lastTxDoneUs = airUs;
+    if (airUs > txStats.maxTxDoneUs)
+      txStats.maxTxDoneUs = airUs;
+    if (txActive.expectsAck)
+    {
+      ackTracker.onSent(txActive.sequence, txActiveStartUs);
+      awaitingAck = true;
+      awaitingAckSequence = txActive.sequence;
+      ackWaitStartUs = micros();
+    }
   }
   else
   {
-    Serial.println("Spectrum test burst failed to transmit");
+    txStats.failed++;
   }
-  LoRa.receive();
+  if (txActive.done)
+    txActive.done(txActive, ok, airUs);
 }
 
-bool beginLoRa()
+// Puts txActive on air.
+void transmitActive()
 {
-  SPI.begin(RADIO_SCLK_PIN, RADIO_MISO_PIN, RADIO_MOSI_PIN, RADIO_CS_PIN);
-  LoRa.setPins(RADIO_CS_PIN, RADIO_RST_PIN, RADIO_DIO0_PIN);
-
-#ifdef RADIO_TCXO_ENABLE
-  pinMode(RADIO_TCXO_ENABLE, OUTPUT);
-  digitalWrite(RADIO_TCXO_ENABLE, HIGH);
-#endif
-
-  if (!LoRa.begin(CONFIG_RADIO_FREQ * 1000000))
+  txDoneFlag = false;
+  if (!LoRa.beginPacket())
   {
-    Serial.println("LoRa init failed. Check wiring.");
-    return false;
+    finishActiveTx(false, 0);
+    return;
   }
-
-  LoRa.setTxPower(CONFIG_RADIO_OUTPUT_POWER);
-  LoRa.setSignalBandwidth(CONFIG_RADIO_BW * 1000);
-  LoRa.setSpreadingFactor(7);
-  LoRa.setCodingRate4(5);
-  LoRa.enableCrc();
-  LoRa.receive();
-
-  Serial.println("LoRa radio ready (TX).");
-  return true;
+  radioAccess.loadPacket(txActive.data, txActive.length);
+  radioAccess.mapDio0TxDone();
+  txActiveStartUs = micros();
+  airtimeBudget.charge(TankControl::timeOnAirUs(radioProfile, txActive.length), txActiveStartUs);
+  LoRa.endPacket(true);
 }
 
-void handleWebRoot()
+void startChannelCheck()
 {
-  server.send_P(200, "text/html", indexPage);
+  LoRa.idle();
+  radioAccess.startCad();
+  txCadStartUs = micros();
 }
 
-void handleWebCommand()
+void startNextTx()
 {
-  if (!server.hasArg("action"))
+  if (txBusy || txStats.depth == 0)
+    return;
+
+  txActive = txQueue[txQueueHead];
+  txQueueHead = (txQueueHead + 1) % kTxQueueDepth;
+  txStats.depth--;
+  txBusy = true;
+  txActiveStartUs = micros();
+
+  LoRa.idle();
+  // A STOP does not listen first: its latency matters more than a collision.
+  if (kLbtEnabled && txActive.command != static_cast<uint8_t>(TankControl::Command::Stop))
   {
-    server.send(400, "application/json", "{\"error\":\"missing action\"}");
+    lbt.start(txActiveStartUs);
+    txListening = true;
+    startChannelCheck();
     return;
   }
+  transmitActive();
+}
 
-  String action = server.arg("action");
-  action.toLowerCase();
-  TankControl::Command cmd = parseCommand(action);
-  bool ok = true;
-
-  if (cmd == TankControl::Command::SetSpeed)
+// Advances the CAD/backoff cycle of txActive and transmits once the channel
+// is clear or ListenBeforeTalk gives up waiting. A CAD that never reports
+// done counts as clear.
+void serviceListenBeforeTalk()
+{
+  uint32_t now = micros();
+  uint32_t cadUs = TankControl::cadTimeUs(radioProfile);
+  if (txBackingOff)
   {
-    int left = server.hasArg("left") ? server.arg("left").toInt() : currentLeftSpeed;
-    int right = server.hasArg("right") ? server.arg("right").toInt() : currentRightSpeed;
-    left = constrain(left, 0, 255);
-    right = constrain(right, 0, 255);
-    currentLeftSpeed = static_cast<uint8_t>(left);
-    currentRightSpeed = static_cast<uint8_t>(right);
-    ok = sendLoRaFrame(cmd, currentLeftSpeed, currentRightSpeed);
-    if (ok)
-      lastState = "SPEED";
+    if (static_cast<int32_t>(txBackoffUntilUs - now) > 0)
+      return;
+    txBackingOff = false;
+    startChannelCheck();
+    return;
   }
-  else
+
+  TankControl::RadioAccess::CadResult result = radioAccess.pollCad();
+  if (result == TankControl::RadioAccess::CadResult::Pending)
   {
-    ok = sendLoRaFrame(cmd, currentLeftSpeed, currentRightSpeed);
-    if (ok)
-    {
-      switch (cmd)
-      {
-      case TankControl::Command::Forward:
-        lastState = "FORWARD";
-        break;
-      case TankControl::Command::Backward:
-        lastState = "BACKWARD";
-        break;
-      case TankControl::Command::Left:
-        lastState = "LEFT";
-        break;
-      case TankControl::Command::Right:
-        lastState = "RIGHT";
-        break;
-      case TankControl::Command::Stop:
-        lastState = "STOP";
-        break;
-      default:
-        break;
-      }
-    }
+    if (now - txCadStartUs < 4 * cadUs + kRadioTaskPeriodMs * 1000)
+      return;
+    LoRa.idle();
+    lbtCadTimeouts++;
+    result = TankControl::RadioAccess::CadResult::Clear;
   }
 
-  if (!ok)
+  uint32_t airUs = TankControl::timeOnAirUs(radioProfile, txActive.length);
+  uint32_t backoffUs = lbt.next(result == TankControl::RadioAccess::CadResult::Busy, cadUs, airUs, esp_random());
+  if (backoffUs == 0)
   {
-    server.send(500, "application/json", "{\"error\":\"lora tx failed\"}");
+    txListening = false;
+    lbt.transmitted(now);
+    transmitActive();
     return;
   }
-
-  String body = "{\"state\":\"";
-  body += lastState;
-  body += "\"}";
-  server.send(200, "application/json", body);
+  // Listen for ACKs while backing off.
+  txBackingOff = true;
+  txBackoffUntilUs = now + backoffUs;
+  LoRa.receive();
 }
 
-void performHttpGet()
+// Completes the frame in the air once TxDone fires (or it times out) and
+// starts the next queued one. Call from radioTask; cheap when idle.
+void serviceTxQueue()
 {
-  if (WiFi.status() != WL_CONNECTED)
+  if (txBusy && txListening)
   {
-    sendStopCommand();
+    serviceListenBeforeTalk();
     return;
   }
-
-  HTTPClient http;
-  http.setTimeout(2000);
-  http.begin(kServerUrl);
-  int httpCode = http.GET();
-
-  if (httpCode == HTTP_CODE_OK)
+  if (txBusy)
   {
-    String payload = http.getString();
-
-    StaticJsonDocument<256> doc;
-    DeserializationError error = deserializeJson(doc, payload);
+    if (txDoneFlag)
+    {
+      finishActiveTx(true, txDoneAtUs - txActiveStartUs);
+    }
+    else if (micros() - txActiveStartUs >= kTxTimeoutUs)
+    {
+      LoRa.idle();
+      finishActiveTx(false, kTxTimeoutUs);
+    }
+    else
+    {
+      return;
+    }
 
-    if (error)
+    // Back to RX between frames so ACKs can come in.
+    if (txStats.depth == 0)
     {
-      Serial.println("JSON parse failed: " + String(error.c_str()));
-      sendStopCommand();
-      http.end();
+      LoRa.receive();
       return;
     }
+  }
 
-    const char *cmdStr = doc["command"] | "STOP";
-    int speedness = doc["speedness"] | 0;
+  if (txStats.depth > 0)
+    startNextTx();
+}
 
-    speedness = constrain(speedness, 0, 100);
-    uint8_t speed = map(speedness, 0, 100, 0, 255);
+// ACK airtime plus the RX turnaround.
+uint32_t ackWindowUs()
+{
+  return TankControl::timeOnAirUs(radioProfile, TankControl::kAckFrameSize) + kAckTurnaroundUs;
+}
 
-    TankControl::Command cmd = TankControl::Command::Stop;
-    if (strcmp(cmdStr, "FORWARD") == 0)
-      cmd = TankControl::Command::Forward;
-    else if (strcmp(cmdStr, "BACKWARD") == 0)
-      cmd = TankControl::Command::Backward;
-    else if (strcmp(cmdStr, "LEFT") == 0)
-      cmd = TankControl::Command::Left;
-    else if (strcmp(cmdStr, "RIGHT") == 0)
-      cmd = TankControl::Command::Right;
-    else if (strcmp(cmdStr, "STOP") == 0)
-      cmd = TankControl::Command::Stop;
+// True while the RX may still be answering the last frame.
+bool inAckWindow()
+{
+  if (!awaitingAck)
+    return false;
+  if (micros() - ackWaitStartUs < ackWindowUs())
+    return true;
+  awaitingAck = false;
+  return false;
+}
 
-    currentLeftSpeed = speed;
-    currentRightSpeed = speed;
-    lastState = cmdStr;
-    lastCommandWasStop = (cmd == TankControl::Command::Stop);
+// Adaptive data rate. The switch is a handshake so both ends always share a
+// profile: SetRadio goes out on the current profile, the RX acknowledges it
+// on that same profile and only then retunes. Once we see the ACK we retune
+// too and confirm with a second SetRadio on the new profile; if nothing is
+// acknowledged within kAdrProbationMs we go back (the RX does the same when
+// it hears nothing valid). Both ends fall back to kBaseRadioProfile after
+// kAdrSilenceMs without traffic, which resynchronises them whatever happened.
+enum class AdrState : uint8_t
+{
+  Stable,
+  Proposing,
+  Probation
+};
 
-    if (sendLoRaFrame(cmd, speed, speed))
-    {
-      Serial.println("From server: " + String(cmdStr) + " @ " + String(speedness) + "%");
-    }
-  }
-  else
-  {
-    Serial.printf("HTTP failed: %d\n", httpCode);
-    sendStopCommand();
-  }
-  http.end();
-}
+struct AdrStats
+{
+  uint32_t proposals = 0;
+  uint32_t switches = 0;
+  uint32_t reverts = 0;
+  uint32_t rejected = 0;
+  uint32_t fallbacks = 0;
+};
 
-// === SETUP ===
-void setup()
+const uint32_t kAdrEvaluateMs = 5000;
+const uint32_t kAdrProbationMs = 2000;
+const uint32_t kAdrSilenceMs = 10000;
+
+TankControl::AdaptiveRate adaptiveRate(kBaseRadioProfile, CONFIG_ADR_ALLOW_BW);
+AdrState adrState = AdrState::Stable;
+AdrStats adrStats;
+size_t adrTarget = 0;
+size_t adrPrevious = 0;
+uint32_t adrProposalSequence = 0;
+uint32_t adrProbationSequence = 0;
+bool adrProposalAcked = false;
+uint32_t adrStateSinceMs = 0;
+uint32_t adrLastEvaluateMs = 0;
+uint32_t adrDeliveredMark = 0;
+uint32_t adrLostMark = 0;
+
+// Retunes the modem. Only call with the TX queue idle.
+void applyRadioProfile(const TankControl::RadioProfile &profile)
 {
-  setupBoards(/*disable_u8g2=*/true);
-  delay(1500);
-  while (!Serial)
-  {
-    delay(10);
-  }
+  LoRa.idle();
+  LoRa.setSignalBandwidth(profile.bandwidthHz);
+  LoRa.setSpreadingFactor(profile.spreadingFactor);
+  LoRa.setCodingRate4(profile.codingRate);
+  LoRa.setPreambleLength(profile.preambleSymbols);
+  radioProfile = profile;
 
-  Serial.println("\nT-Beam TX | LoRa Tank Controller");
+  // A frame and its ACK must fit in the ACK timeout even at SF12.
+  uint32_t roundTripUs = TankControl::timeOnAirUs(profile, kWireTrajectorySize) +
+                         TankControl::timeOnAirUs(profile, TankControl::kAckFrameSize) + kAckTurnaroundUs;
+  ackTracker.setTimeoutUs(max<uint32_t>(kAckTimeoutUs, 2 * roundTripUs));
+  LoRa.receive();
+}
 
-  bool radioReady = beginLoRa();
-  if (!radioReady)
+void adrOnAck(const TankControl::AckTelemetry &ack)
+{
+  // The link is as good as its weaker direction.
+  float snrDb = min(ack.snrQuarterDb / 4.0f, linkTelemetry.localSnrDb);
+  float rssiDbm = min<float>(ack.rssiDbm, linkTelemetry.localRssiDbm);
+  adaptiveRate.addSample(snrDb, rssiDbm);
+
+  // Probation ends on an ACK at or after its sequence, compared modulo 2^32
+  // so the end of the epoch space cannot strand it.
+  if (adrState == AdrState::Proposing && ack.sequence == adrProposalSequence)
   {
-    Serial.println("LoRa setup failed; reboot after checking the radio module.");
-    while (true)
-      delay(1000);
+    adrProposalAcked = true;
   }
-  else
+  else if (adrState == AdrState::Probation && static_cast<int32_t>(ack.sequence - adrProbationSequence) >= 0)
   {
-    randomSeed(esp_random());
-    sendSpectrumTestBurst();
+    adrState = AdrState::Stable;
+    adrStats.switches++;
+    Serial.printf("ADR: now SF%u/%ukHz\n", radioProfile.spreadingFactor,
+                  static_cast<unsigned>(radioProfile.bandwidthHz / 1000));
   }
+}
 
-  sendStopCommand();
+// Reads a packet flagged by serviceRadioIrq(), matches it to a sent frame
+// and retires timed-out frames. Runs before anything on the radio task can
+// start a transmission, so the FIFO is read before it is reused.
+void serviceReceive()
+{
+  if (rxPendingFlag)
+  {
+    rxPendingFlag = false;
+    int size = rxPendingSize;
+    uint8_t packet[TankControl::kAckFrameSize];
+    size_t length = size > 0 ? radioAccess.readPacket(packet, sizeof(packet), size) : 0;
+
+    TankControl::AckTelemetry ack;
+    uint32_t rttUs = 0;
+    if (size != static_cast<int>(TankControl::kAckFrameSize) || !cipher.openAck(packet, length, ack) ||
+        ack.vehicle == TankControl::kBroadcastVehicle || ack.vehicle > kFleetSize)
+    {
+      linkTelemetry.badFrames++;
+    }
+    else
+    {
+      linkTelemetry.lastAckMs = millis();
+      linkTelemetry.remoteRssiDbm = ack.rssiDbm;
+      linkTelemetry.remoteSnrQuarterDb = ack.snrQuarterDb;
+      linkTelemetry.localRssiDbm = static_cast<int16_t>(LoRa.packetRssi());
+      linkTelemetry.localSnrDb = LoRa.packetSnr();
+      linkTelemetry.leftMotor = ack.leftMotor;
+      linkTelemetry.rightMotor = ack.rightMotor;
+      linkTelemetry.status = ack.status;
+      if (ackTracker.onAck(ack.sequence, rxAtUs, rttUs) && ack.sequence == awaitingAckSequence)
+        awaitingAck = false;
+      if (CONFIG_ADR_ENABLE)
+        adrOnAck(ack);
+    }
+  }
+  ackTracker.expire(micros());
+}
+
+// Appends a packet to the TX queue and starts it if the radio is free.
+// command is only used for logging and STOP pre-emption.
+bool enqueueTxPacket(const uint8_t *payload, size_t length, uint8_t command, uint32_t sequence,
+                     bool expectsAck, TxDoneCallback done)
+{
+  if (txStats.depth >= kTxQueueDepth)
+  {
+    txStats.dropped++;
+    return false;
+  }
+
+  TxRequest &request = txQueue[(txQueueHead + txStats.depth) % kTxQueueDepth];
+  memcpy(request.data, payload, length);
+  request.length = static_cast<uint8_t>(length);
+  request.command = command;
+  request.sequence = sequence;
+  request.expectsAck = expectsAck;
+  request.done = done;
+  txStats.depth++;
+  if (txStats.depth > txStats.maxDepth)
+    txStats.maxDepth = txStats.depth;
+
+  startNextTx();
+  return true;
+}
+
+// Queues an encrypted packet for transmission and starts it at once if the
+// radio is free. Returns false if the packet does not fit or the queue is
+// full. An ACK is awaited unless the packet is a broadcast. txStartUs, if
+// given, receives micros() when a STOP went on air.
+bool queueLoRaPacket(const uint8_t *payload, size_t length, TankControl::Command cmd,
+                     uint32_t sequence, uint8_t vehicle, uint32_t *txStartUs = nullptr,
+                     TxDoneCallback done = logTxDone)
+{
+  if (length > sizeof(txQueue[0].data))
+    return false;
+
+  bool isStop = cmd == TankControl::Command::Stop;
+  if (isStop)
+  {
+    // Everything not yet on air is superseded by the stop; keep queued stops.
+    size_t kept = 0;
+    for (size_t i = 0; i < txStats.depth; ++i)
+    {
+      const TxRequest &pending = txQueue[(txQueueHead + i) % kTxQueueDepth];
+      if (pending.command == static_cast<uint8_t>(TankControl::Command::Stop))
+        txQueue[(txQueueHead + kept++) % kTxQueueDepth] = pending;
+      else
+        txStats.preempted++;
+    }
+    txStats.depth = kept;
+
+    if (txBusy && txActive.command != static_cast<uint8_t>(TankControl::Command::Stop))
+    {
+      LoRa.idle();
+      txStats.preempted++;
+      finishActiveTx(false, micros() - txActiveStartUs);
+    }
+  }
+
+  if (!enqueueTxPacket(payload, length, static_cast<uint8_t>(cmd), sequence,
+                       TankControl::acknowledged(kWireVersion, vehicle), done))
+    return false;
+  if (txStartUs && txBusy && txActive.sequence == sequence)
+    *txStartUs = txActiveStartUs;
+  return true;
+}
+
+// ========================================
+// RADIO TASK (core 1)
+// Owns the cipher, the STOP cache and the TX queue. Everything below runs
+// only on radioTask; the network side reaches it through radioRing.
+// ========================================
+// Heartbeat. The RX dead-man timer must hear from us every kHeartbeatMs.
+// Any frame a vehicle can authenticate counts, so heartbeats only fill the
+// gaps in regular traffic. livenessMs holds when each vehicle last got a
+// frame addressed to it or broadcast.
+const uint32_t kHeartbeatMs = CONFIG_HEARTBEAT_MS;
+
+struct HeartbeatStats
+{
+  uint32_t sent = 0;
+  uint32_t failed = 0;
+  uint32_t deferred = 0;
+};
+
+uint32_t livenessMs[kFleetSize] = {};
+HeartbeatStats heartbeatStats;
+bool heartbeatDeferred = false;
+
+void noteLiveness(uint8_t vehicle)
+{
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < kFleetSize; ++i)
+  {
+    if (vehicle == TankControl::kBroadcastVehicle || vehicle == i + 1)
+      livenessMs[i] = now;
+  }
+}
+
+bool radioSendFrame(uint8_t vehicle, TankControl::Command cmd, uint8_t leftSpeed, uint8_t rightSpeed,
+                    uint32_t *txStartUs = nullptr)
+{
+  uint32_t sequence = 0;
+  if (!takeSequence(sequence))
+    return false;
+  TankControl::ControlFrame frame;
+  TankControl::initFrame(frame, cmd, leftSpeed, rightSpeed, sequence);
+
+  uint8_t encrypted[TankControl::kFrameSize];
+  size_t encryptedLength = 0;
+#if CONFIG_PROTOCOL_VERSION == 2
+  encryptedLength = cipher.sealV2(frame, vehicle, static_cast<uint16_t>(millis()), encrypted, sizeof(encrypted));
+#else
+  if (cipher.encrypt(frame, encrypted, sizeof(encrypted)))
+    encryptedLength = TankControl::kFrameSize;
+#endif
+  if (encryptedLength == 0)
+  {
+    Serial.println("Encrypt failed");
+    return false;
+  }
+
+  bool ok = queueLoRaPacket(encrypted, encryptedLength, cmd, sequence, vehicle, txStartUs);
+  if (ok)
+  {
+    noteLiveness(vehicle);
+  }
+  else
+  {
+    Serial.println("LoRa TX queue full");
+  }
+  return ok;
+}
+
+bool radioSendTrajectory(uint8_t vehicle, const TankControl::TrajectorySegment *segments, size_t count)
+{
+  uint32_t sequence = 0;
+  if (!takeSequence(sequence))
+    return false;
+  TankControl::TrajectoryPacket packet;
+  if (!TankControl::initTrajectory(packet, segments, count, sequence, vehicle))
+  {
+    Serial.println("Invalid trajectory");
+    return false;
+  }
+
+  uint8_t encrypted[TankControl::kTrajectoryPacketSize];
+  size_t encryptedLength = 0;
+#if CONFIG_PROTOCOL_VERSION == 2
+  encryptedLength = cipher.sealTrajectoryV2(packet, static_cast<uint16_t>(millis()), encrypted, sizeof(encrypted));
+#else
+  if (cipher.encryptTrajectory(packet, encrypted, sizeof(encrypted)))
+    encryptedLength = TankControl::kTrajectoryPacketSize;
+#endif
+  if (encryptedLength == 0)
+  {
+    Serial.println("Encrypt failed");
+    return false;
+  }
+
+  bool ok = queueLoRaPacket(encrypted, encryptedLength, TankControl::Command::Trajectory,
+                            sequence, vehicle);
+
+  if (ok)
+  {
+    noteLiveness(vehicle);
+    uint32_t totalMs = 0;
+    for (size_t i = 0; i < count; ++i)
+      totalMs += segments[i].durationMs;
+    Serial.printf("TX queued -> trajectory seq=%u vehicle=%u segments=%u total=%ums\n",
+                  static_cast<unsigned>(sequence), vehicle, static_cast<unsigned>(count),
+                  static_cast<unsigned>(totalMs));
+  }
+  else
+  {
+    Serial.println("LoRa TX queue full");
+  }
+  return ok;
+}
+
+// Sends STOP, from the pre-encrypted cache when possible. triggerUs is when
+// the stop was requested (by either task) and feeds stopLatency. The cache
+// only holds broadcast stops; a stop for one vehicle of a fleet is built.
+bool radioSendStop(uint32_t triggerUs, uint8_t vehicle = TankControl::kBroadcastVehicle)
+{
+  uint32_t txStartUs = 0;
+  size_t cachedLength = 0;
+  const uint8_t *cached = nullptr;
+  if (vehicle == TankControl::kBroadcastVehicle)
+    cached = stopCache.lookup(sequenceCounter, cachedLength);
+  bool ok;
+  if (cached)
+  {
+    uint32_t sequence = 0;
+    ok = takeSequence(sequence) &&
+         queueLoRaPacket(cached, cachedLength, TankControl::Command::Stop, sequence,
+                         TankControl::kBroadcastVehicle, &txStartUs);
+    if (ok)
+      noteLiveness(TankControl::kBroadcastVehicle);
+    stopLatency.cacheHits++;
+  }
+  else
+  {
+    ok = radioSendFrame(vehicle, TankControl::Command::Stop, 0, 0, &txStartUs);
+    stopLatency.cacheMisses++;
+  }
+  if (vehicle == TankControl::kBroadcastVehicle)
+    radioStopped = radioStopped || ok;
+
+  // txStartUs stays 0 if the stop had to queue behind another stop.
+  if (ok && txStartUs != 0)
+  {
+    stopLatency.lastUs = txStartUs - triggerUs;
+    if (stopLatency.lastUs > stopLatency.maxUs)
+      stopLatency.maxUs = stopLatency.lastUs;
+    Serial.printf("SAFETY STOP sent: No connection or server error. (%s, trigger->TX %u us)\n",
+                  cached ? "cached" : "built", static_cast<unsigned>(stopLatency.lastUs));
+  }
+  return ok;
+}
+
+// Rebuilds the pre-encrypted STOP frames consumed since the last call.
+void refreshStopCache()
+{
+  stopCache.refill(cipher, kWireVersion, sequenceCounter, static_cast<uint16_t>(millis()));
+}
+
+// Scheduler: drive commands and trajectories each describe the whole
+// desired state of a vehicle, so only the newest unsent one per vehicle
+// matters. It waits in that vehicle's latest-wins slot until the radio is
+// idle and the airtime budget covers it; with a fleet it also waits for the
+// vehicle's TDMA slot. STOP skips the slots and goes out at once.
+RadioRequest pendingRequests[kFleetSize];
+bool hasPendingRequest[kFleetSize] = {};
+bool pendingDeferred[kFleetSize] = {};
+
+// Per-vehicle delivery of scheduled commands: how often each vehicle's
+// slot was used and how long its commands waited for it.
+struct FleetStats
+{
+  uint32_t served[kFleetSize] = {};
+  uint32_t lastWaitUs[kFleetSize] = {};
+  uint32_t maxWaitUs[kFleetSize] = {};
+};
+FleetStats fleetStats;
+
+void notePushDispatch(const RadioRequest &request)
+{
+  if (!request.fromPush)
+    return;
+  uint32_t pushUs = micros() - request.pushRxUs;
+  pipelineStats.pushDispatched++;
+  pipelineStats.lastPushUs = pushUs;
+  pipelineStats.totalPushUs += pushUs;
+  if (pushUs > pipelineStats.maxPushUs)
+    pipelineStats.maxPushUs = pushUs;
+}
+
+size_t wireLength(const RadioRequest &request)
+{
+  return request.kind == RadioRequestKind::Trajectory ? wireTrajectorySize(request.segmentCount) : kWireFrameSize;
+}
+
+void handleRadioRequest(const RadioRequest &request)
+{
+  uint32_t queuedUs = micros() - request.postedUs;
+  pipelineStats.handled++;
+  pipelineStats.lastQueueUs = queuedUs;
+  pipelineStats.totalQueueUs += queuedUs;
+  if (queuedUs > pipelineStats.maxQueueUs)
+    pipelineStats.maxQueueUs = queuedUs;
+
+  if (request.kind == RadioRequestKind::Stop)
+  {
+    // A single vehicle is stopped with the cached broadcast frame.
+    uint8_t target = kFleetSize == 1 ? TankControl::kBroadcastVehicle : request.vehicle;
+    for (uint8_t i = 0; i < kFleetSize; ++i)
+    {
+      if (target == TankControl::kBroadcastVehicle || target == i + 1)
+        hasPendingRequest[i] = false;
+    }
+    notePushDispatch(request);
+    radioSendStop(request.postedUs, target);
+    return;
+  }
+
+  size_t slot = request.vehicle - 1;
+  if (hasPendingRequest[slot])
+    pipelineStats.coalesced++;
+  pendingRequests[slot] = request;
+  hasPendingRequest[slot] = true;
+  pendingDeferred[slot] = false;
+}
+
+void dispatchPendingRequest()
+{
+  if (txBusy || txStats.depth > 0 || inAckWindow())
+    return;
+
+  uint8_t vehicle = 1;
+  if (kFleetSize > 1)
+  {
+    uint32_t intoSlotUs = 0;
+    vehicle = tdma.ownerAt(micros(), intoSlotUs);
+    if (!hasPendingRequest[vehicle - 1])
+      return;
+    uint32_t busyUs = TankControl::timeOnAirUs(radioProfile, wireLength(pendingRequests[vehicle - 1])) + ackWindowUs();
+    if (tdma.claim(micros(), busyUs) != vehicle)
+      return;
+  }
+  size_t slot = vehicle - 1;
+  if (!hasPendingRequest[slot])
+    return;
+
+  const RadioRequest &request = pendingRequests[slot];
+  uint32_t airUs = TankControl::timeOnAirUs(radioProfile, wireLength(request));
+  if (!airtimeBudget.allows(airUs, micros()))
+  {
+    if (!pendingDeferred[slot])
+    {
+      pendingDeferred[slot] = true;
+      pipelineStats.budgetDeferred++;
+    }
+    return;
+  }
+  hasPendingRequest[slot] = false;
+  if (kFleetSize > 1)
+    tdma.markClaimed();
+
+  uint32_t waitUs = micros() - request.postedUs;
+  fleetStats.served[slot]++;
+  fleetStats.lastWaitUs[slot] = waitUs;
+  if (waitUs > fleetStats.maxWaitUs[slot])
+    fleetStats.maxWaitUs[slot] = waitUs;
+  notePushDispatch(request);
+
+  TankControl::Command cmd = static_cast<TankControl::Command>(request.command);
+  if (request.kind == RadioRequestKind::Trajectory)
+  {
+    if (radioSendTrajectory(request.vehicle, request.segments, request.segmentCount))
+      radioStopped = false;
+  }
+  else if (radioSendFrame(request.vehicle, cmd, request.leftSpeed, request.rightSpeed))
+  {
+    radioStopped = false;
+  }
+}
+
+void logHeartbeatDone(const TxRequest &request, bool ok, uint32_t airUs)
+{
+  if (ok)
+  {
+    heartbeatStats.sent++;
+    return;
+  }
+  heartbeatStats.failed++;
+  logTxDone(request, ok, airUs);
+}
+
+// Sends a broadcast heartbeat once some vehicle has gone kHeartbeatMs
+// without a frame. Nothing is sent after a fleet-wide STOP: a stopped
+// vehicle has nothing for its dead-man timer to protect. Heartbeats are
+// never ACKed, wait for the airtime budget like commands, and in a fleet
+// only start in a free TDMA slot they fit in, without using it up.
+void serviceHeartbeat()
+{
+  if (kHeartbeatMs == 0 || radioStopped || txBusy || txStats.depth > 0 || inAckWindow())
+    return;
+
+  uint32_t now = millis();
+  uint32_t silentMs = 0;
+  for (uint8_t i = 0; i < kFleetSize; ++i)
+  {
+    if (now - livenessMs[i] > silentMs)
+      silentMs = now - livenessMs[i];
+  }
+  if (silentMs < kHeartbeatMs)
+    return;
+
+  uint32_t airUs = TankControl::timeOnAirUs(radioProfile, TankControl::kHeartbeatFrameSize);
+  if (kFleetSize > 1 && tdma.claim(micros(), airUs) == TankControl::kBroadcastVehicle)
+    return;
+  if (!airtimeBudget.allows(airUs, micros()))
+  {
+    if (!heartbeatDeferred)
+    {
+      heartbeatDeferred = true;
+      heartbeatStats.deferred++;
+    }
+    return;
+  }
+  heartbeatDeferred = false;
+
+  uint32_t sequence = 0;
+  if (!takeSequence(sequence))
+    return;
+  uint8_t frame[TankControl::kHeartbeatFrameSize];
+  if (cipher.sealHeartbeat(sequence, kHeartbeatMs, frame, sizeof(frame)) == 0)
+  {
+    Serial.println("Encrypt failed");
+    return;
+  }
+  if (enqueueTxPacket(frame, sizeof(frame), TankControl::kHeartbeatFrameKind, sequence, false, logHeartbeatDone))
+    noteLiveness(TankControl::kBroadcastVehicle);
+}
+
+// Sizes the TDMA slots for the largest frame (a trajectory) plus its ACK and
+// reports what the configured fleet can expect.
+void configureFleet()
+{
+  fleetLimits = TankControl::fleetTiming(radioProfile, kFleetSize, kWireTrajectorySize,
+                                         ackWindowUs(), kTdmaGuardUs, airtimeBudget.budgetUs(),
+                                         CONFIG_FLEET_LATENCY_TARGET_MS * 1000UL);
+  tdma.configure(kFleetSize, fleetLimits.slotUs);
+  Serial.printf("Fleet: %u vehicle(s), slot %uus, round %uus, worst-case latency %uus, "
+                "%u.%03u cmd/s per vehicle, capacity %u vehicle(s) within %ums\n",
+                kFleetSize, static_cast<unsigned>(fleetLimits.slotUs), static_cast<unsigned>(fleetLimits.roundUs),
+                static_cast<unsigned>(fleetLimits.worstLatencyUs),
+                static_cast<unsigned>(fleetLimits.perVehicleRateMilliHz / 1000),
+                static_cast<unsigned>(fleetLimits.perVehicleRateMilliHz % 1000), fleetLimits.maxVehiclesForTarget,
+                static_cast<unsigned>(CONFIG_FLEET_LATENCY_TARGET_MS));
+  if (fleetLimits.worstLatencyUs > CONFIG_FLEET_LATENCY_TARGET_MS * 1000UL)
+    Serial.println("Fleet: WARNING worst-case latency exceeds the target; reduce the fleet or use a faster profile");
+}
+
+// Reports the heartbeat cost and the stop bound it gives the RX.
+void reportHeartbeat()
+{
+  if (kHeartbeatMs == 0)
+  {
+    Serial.println("Heartbeat: disabled, the RX dead-man timer will not be fed between commands");
+    return;
+  }
+  uint32_t airUs = TankControl::timeOnAirUs(radioProfile, TankControl::kHeartbeatFrameSize);
+  Serial.printf("Heartbeat: every %ums without traffic, %uus on air, RX stops within %ums of silence\n",
+                static_cast<unsigned>(kHeartbeatMs), static_cast<unsigned>(airUs),
+                static_cast<unsigned>(kHeartbeatMs * TankControl::DeadManTimer::kMissedHeartbeats));
+  if (static_cast<uint64_t>(airUs) * 1000 > static_cast<uint64_t>(airtimeBudget.budgetUs()) * kHeartbeatMs)
+    Serial.println("Heartbeat: WARNING the airtime budget cannot carry the heartbeat rate");
+}
+
+// The STOP deadline: in MODE 2 the vehicle must stop once the network task
+// has gone kNetworkStopDeadlineMs without a good poll, however long it is
+// stuck (HTTP timeout, WiFi reconnect, a full ring).
+void checkStopDeadline()
+{
+  if (MODE != 2 || radioStopped)
+    return;
+  if (millis() - networkOkMs.load(std::memory_order_acquire) < kNetworkStopDeadlineMs)
+    return;
+  Serial.println("Network deadline missed -> STOP");
+  pipelineStats.deadlineStops++;
+  radioSendStop(micros());
+}
+
+bool adrSendSetRadio(const TankControl::RadioProfile &profile, uint32_t &sequence)
+{
+  sequence = sequenceCounter;
+  return radioSendFrame(1, TankControl::Command::SetRadio, profile.spreadingFactor,
+                        TankControl::bandwidthCode(profile.bandwidthHz));
+}
+
+// Drives the SetRadio handshake. Runs on radioTask, and only acts while the
+// radio is idle so a retune never cuts a frame or an ACK short.
+void serviceAdaptiveRate()
+{
+  if (!CONFIG_ADR_ENABLE || txBusy || txStats.depth > 0 || inAckWindow())
+    return;
+
+  uint32_t now = millis();
+  switch (adrState)
+  {
+  case AdrState::Stable:
+    if (adaptiveRate.current() != adaptiveRate.home() && now - linkTelemetry.lastAckMs >= kAdrSilenceMs &&
+        now - adrStateSinceMs >= kAdrSilenceMs)
+    {
+      Serial.println("ADR: link silent, back to base profile");
+      adrStats.fallbacks++;
+      adaptiveRate.setCurrent(adaptiveRate.home());
+      applyRadioProfile(adaptiveRate.profile());
+      adrStateSinceMs = now;
+      return;
+    }
+    if (now - adrLastEvaluateMs >= kAdrEvaluateMs)
+    {
+      adrLastEvaluateMs = now;
+      uint32_t delivered = ackTracker.delivered() - adrDeliveredMark;
+      uint32_t lost = ackTracker.lost() - adrLostMark;
+      adrDeliveredMark = ackTracker.delivered();
+      adrLostMark = ackTracker.lost();
+      size_t target = adaptiveRate.evaluate(delivered, lost);
+      if (target == adaptiveRate.current())
+        return;
+      const TankControl::RadioProfile &next = adaptiveRate.step(target);
+      uint32_t airUs = TankControl::timeOnAirUs(radioProfile, kWireFrameSize);
+      if (!airtimeBudget.allows(airUs, micros()) || !adrSendSetRadio(next, adrProposalSequence))
+        return;
+      Serial.printf("ADR: margin %.1fdB, %u/%u lost -> propose SF%u/%ukHz\n", adaptiveRate.lastMarginDb(),
+                    static_cast<unsigned>(lost), static_cast<unsigned>(delivered + lost), next.spreadingFactor,
+                    static_cast<unsigned>(next.bandwidthHz / 1000));
+      adrStats.proposals++;
+      adrTarget = target;
+      adrProposalAcked = false;
+      adrState = AdrState::Proposing;
+      adrStateSinceMs = now;
+    }
+    break;
+
+  case AdrState::Proposing:
+    if (adrProposalAcked)
+    {
+      adrPrevious = adaptiveRate.current();
+      adaptiveRate.setCurrent(adrTarget);
+      applyRadioProfile(adaptiveRate.profile());
+      adrSendSetRadio(radioProfile, adrProbationSequence);
+      adrState = AdrState::Probation;
+      adrStateSinceMs = now;
+      // Judge the new profile on its own traffic only.
+      adrLastEvaluateMs = now;
+      adrDeliveredMark = ackTracker.delivered();
+      adrLostMark = ackTracker.lost();
+    }
+    else if (now - adrStateSinceMs >= kAdrProbationMs)
+    {
+      // The RX never confirmed, so it is still on the current profile.
+      adrStats.rejected++;
+      adrState = AdrState::Stable;
+      adrStateSinceMs = now;
+    }
+    break;
+
+  case AdrState::Probation:
+    if (now - adrStateSinceMs >= kAdrProbationMs)
+    {
+      Serial.println("ADR: no ACK on new profile, reverting");
+      adrStats.reverts++;
+      adaptiveRate.setCurrent(adrPrevious);
+      applyRadioProfile(adaptiveRate.profile());
+      adrState = AdrState::Stable;
+      adrStateSinceMs = now;
+    }
+    break;
+  }
+}
+
+void radioTask(void *)
+{
+  for (;;)
+  {
+    uint32_t busyStartUs = micros();
+
+    // Before any request can start a transmission over the FIFO.
+    serviceRadioIrq();
+    serviceReceive();
+    RadioRequest request;
+    while (radioRing.pop(request))
+      handleRadioRequest(request);
+    checkStopDeadline();
+    serviceTxQueue();
+    dispatchPendingRequest();
+    serviceHeartbeat();
+    serviceAdaptiveRate();
+    refreshStopCache();
+
+    radioLoad.add(micros() - busyStartUs);
+    // Woken early by radioRing pushes and the DIO0 interrupt.
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(kRadioTaskPeriodMs));
+  }
+}
+
+// ========================================
+// NETWORK SIDE (core 0)
+// These only post requests to radioRing; they never touch the radio.
+// ========================================
+// While a push event is being applied, the requests it posts carry its
+// arrival time.
+bool applyingPush = false;
+uint32_t pushEventRxUs = 0;
+
+bool postRadioRequest(RadioRequest &request)
+{
+  request.postedUs = micros();
+  request.fromPush = applyingPush;
+  request.pushRxUs = pushEventRxUs;
+  if (!radioRing.push(request))
+  {
+    pipelineStats.postFailed++;
+    Serial.println("Radio ring full");
+    return false;
+  }
+  if (radioTaskHandle)
+    xTaskNotifyGive(radioTaskHandle);
+  return true;
+}
+
+bool sendLoRaFrame(uint8_t vehicle, TankControl::Command cmd, uint8_t leftSpeed, uint8_t rightSpeed)
+{
+  RadioRequest request;
+  request.kind = cmd == TankControl::Command::Stop ? RadioRequestKind::Stop : RadioRequestKind::Frame;
+  request.vehicle = vehicle;
+  request.command = static_cast<uint8_t>(cmd);
+  request.leftSpeed = leftSpeed;
+  request.rightSpeed = rightSpeed;
+  request.segmentCount = 0;
+  return postRadioRequest(request);
+}
+
+// Maps a -100..100 % wheel command to the int8 velocity carried by Drive frames.
+int8_t velocityFromPercent(int percent)
+{
+  percent = constrain(percent, -100, 100);
+  return static_cast<int8_t>(percent * 127 / 100);
+}
+
+bool sendDriveFrame(uint8_t vehicle, int8_t leftVelocity, int8_t rightVelocity)
+{
+  bool ok = sendLoRaFrame(vehicle, TankControl::Command::Drive,
+                          static_cast<uint8_t>(leftVelocity),
+                          static_cast<uint8_t>(rightVelocity));
+  if (ok)
+  {
+    vehicleState(vehicle).lastState = "DRIVE";
+    vehicleState(vehicle).lastCommandWasStop = false;
+  }
+  return ok;
+}
+
+// Sends up to kMaxTrajectorySegments timed drive segments in one packet; the
+// RX plays them back from its own clock.
+bool sendLoRaTrajectory(uint8_t vehicle, const TankControl::TrajectorySegment *segments, size_t count)
+{
+  if (count == 0 || count > TankControl::kMaxTrajectorySegments)
+  {
+    Serial.println("Invalid trajectory");
+    return false;
+  }
+
+  RadioRequest request;
+  request.kind = RadioRequestKind::Trajectory;
+  request.vehicle = vehicle;
+  request.command = static_cast<uint8_t>(TankControl::Command::Trajectory);
+  request.leftSpeed = 0;
+  request.rightSpeed = 0;
+  request.segmentCount = static_cast<uint8_t>(count);
+  memcpy(request.segments, segments, count * sizeof(segments[0]));
+  return postRadioRequest(request);
+}
+
+// Stops one vehicle unless it is already stopped.
+void sendVehicleStop(uint8_t vehicle)
+{
+  VehicleCommandState &state = vehicleState(vehicle);
+  if (state.lastCommandWasStop && state.leftSpeed == 0 && state.rightSpeed == 0)
+    return;
+
+  state.leftSpeed = 0;
+  state.rightSpeed = 0;
+  state.lastState = "STOP";
+  state.lastCommandWasStop = true;
+  sendLoRaFrame(vehicle, TankControl::Command::Stop, 0, 0);
+}
+
+// Safety stop for the whole fleet, sent once as a broadcast.
+void sendStopCommand()
+{
+  bool allStopped = true;
+  for (VehicleCommandState &state : vehicleStates)
+  {
+    allStopped = allStopped && state.lastCommandWasStop && state.leftSpeed == 0 && state.rightSpeed == 0;
+    state.leftSpeed = 0;
+    state.rightSpeed = 0;
+    state.lastState = "STOP";
+    state.lastCommandWasStop = true;
+  }
+  if (allStopped)
+  {
+    return;
+  }
+
+  sendLoRaFrame(TankControl::kBroadcastVehicle, TankControl::Command::Stop, 0, 0);
+}
+
+#ifdef CONFIG_CIPHER_BENCH
+// Compares the one-shot encryptFrame()/decryptFrame() helpers with the
+// persistent CipherSession, in CPU cycles per 16-byte frame.
+void runCipherBenchmark()
+{
+  static constexpr uint32_t kIterations = 1000;
+  static constexpr size_t kBatch = 8;
+  TankControl::ControlFrame frames[kBatch];
+  for (size_t i = 0; i < kBatch; ++i)
+  {
+    TankControl::initFrame(frames[i], TankControl::Command::Forward, 200, 200, i);
+  }
+  uint8_t encrypted[kBatch * TankControl::kFrameSize];
+  TankControl::ControlFrame decoded[kBatch];
+
+  uint32_t start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+    TankControl::encryptFrame(frames[0], encrypted, TankControl::kFrameSize);
+  uint32_t oneShotEnc = (ESP.getCycleCount() - start) / kIterations;
+
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+    TankControl::decryptFrame(encrypted, TankControl::kFrameSize, decoded[0]);
+  uint32_t oneShotDec = (ESP.getCycleCount() - start) / kIterations;
+
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+    cipher.encrypt(frames[0], encrypted, TankControl::kFrameSize);
+  uint32_t sessionEnc = (ESP.getCycleCount() - start) / kIterations;
+
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+    cipher.decrypt(encrypted, TankControl::kFrameSize, decoded[0]);
+  uint32_t sessionDec = (ESP.getCycleCount() - start) / kIterations;
+
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+    cipher.encryptBatch(frames, kBatch, encrypted, sizeof(encrypted));
+  uint32_t batchEnc = (ESP.getCycleCount() - start) / (kIterations * kBatch);
+
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+    cipher.decryptBatch(encrypted, kBatch, decoded);
+  uint32_t batchDec = (ESP.getCycleCount() - start) / (kIterations * kBatch);
+
+  uint8_t sealed[TankControl::kAeadFrameSize];
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+  {
+    frames[0].sequence = i;
+    cipher.sealV2(frames[0], 1, static_cast<uint16_t>(i), sealed, sizeof(sealed));
+  }
+  uint32_t aeadSeal = (ESP.getCycleCount() - start) / kIterations;
+
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kIterations; ++i)
+    cipher.openV2(sealed, sizeof(sealed), decoded[0]);
+  uint32_t aeadOpen = (ESP.getCycleCount() - start) / kIterations;
+
+  Serial.printf("Cipher cycles/frame: one-shot enc=%u dec=%u | session enc=%u dec=%u | batch(%u) enc=%u dec=%u\n",
+                oneShotEnc, oneShotDec, sessionEnc, sessionDec,
+                static_cast<unsigned>(kBatch), batchEnc, batchDec);
+  Serial.printf("v1 CBC+CRC: %u bytes on air, enc=%u dec=%u | v2 CCM: %u bytes on air, seal=%u open=%u\n",
+                static_cast<unsigned>(TankControl::kFrameSize), sessionEnc, sessionDec,
+                static_cast<unsigned>(TankControl::kAeadFrameSize), aeadSeal, aeadOpen);
+}
+#endif
+
+#ifdef CONFIG_RADIO_SPI_BENCH
+// Host-to-FIFO time per packet: the LoRa driver's byte-per-transaction
+// write()/available()+read() against one RadioAccess burst, at
+// CONFIG_RADIO_SPI_HZ. The radio stays in standby, so nothing goes on air.
+void runRadioSpiBenchmark()
+{
+  static constexpr uint32_t kIterations = 200;
+  static const size_t kSizes[] = {8, 15, 16, 64, 128, 255};
+  uint8_t payload[TankControl::RadioAccess::kMaxPacketSize];
+  for (size_t i = 0; i < sizeof(payload); ++i)
+    payload[i] = static_cast<uint8_t>(i * 37);
+
+  uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+  Serial.printf("Radio SPI @ %u Hz, us/packet (driver -> burst):\n", static_cast<unsigned>(CONFIG_RADIO_SPI_HZ));
+  LoRa.idle();
+  for (size_t size : kSizes)
+  {
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+      LoRa.beginPacket();
+      LoRa.write(payload, size);
+    }
+    uint32_t driverWrite = (ESP.getCycleCount() - start) / kIterations;
+
+    start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+      LoRa.beginPacket();
+      radioAccess.loadPacket(payload, size);
+    }
+    uint32_t burstWrite = (ESP.getCycleCount() - start) / kIterations;
+
+    // In standby RegRxNbBytes is 0, so the driver's read loop is timed
+    // explicitly: one available() and one read() per byte, as in RX.
+    start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < kIterations; ++i)
+    {
+      for (size_t b = 0; b < size; ++b)
+      {
+        LoRa.available();
+        payload[b] = static_cast<uint8_t>(LoRa.read());
+      }
+    }
+    uint32_t driverRead = (ESP.getCycleCount() - start) / kIterations;
+
+    start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < kIterations; ++i)
+      radioAccess.readPacket(payload, sizeof(payload), size);
+    uint32_t burstRead = (ESP.getCycleCount() - start) / kIterations;
+
+    Serial.printf("  %3u B: write %7.1f -> %6.1f | read %7.1f -> %6.1f\n", static_cast<unsigned>(size),
+                  static_cast<float>(driverWrite) / cyclesPerUs, static_cast<float>(burstWrite) / cyclesPerUs,
+                  static_cast<float>(driverRead) / cyclesPerUs, static_cast<float>(burstRead) / cyclesPerUs);
+  }
+}
+#endif
+
+// ========================================
+// LINK BENCHMARK (MODE 3 sender, MODE 4 receiver)
+// The sender sweeps every combination below. Each step is announced on the
+// base profile, probed on its own profile and reported back by the
+// receiver on the base profile; the sender prints one JSON line per step.
+// Probes are paced to CONFIG_AIRTIME_BUDGET_MS, so duty-cycle limits hold.
+// ========================================
+const uint8_t kBenchSpreadingFactors[] = {7, 9, 12};
+const uint32_t kBenchBandwidthsHz[] = {125000, 500000};
+const uint8_t kBenchCodingRates[] = {5, 8};
+const uint8_t kBenchPayloadSizes[] = {16, 64, 192};
+const int8_t kBenchTxPowersDbm[] = {10, 17};
+
+const uint32_t kBenchStepAirMs = 10000;
+const uint16_t kBenchMinProbes = 10;
+const uint32_t kBenchSettleMs = 50;
+const uint32_t kBenchTailMs = 100;
+const uint32_t kBenchReportGuardMs = 300;
+
+template <typename T, size_t N>
+constexpr size_t benchAxis(const T (&)[N])
+{
+  return N;
+}
+
+const size_t kBenchSteps = benchAxis(kBenchSpreadingFactors) * benchAxis(kBenchBandwidthsHz) *
+                           benchAxis(kBenchCodingRates) * benchAxis(kBenchPayloadSizes) *
+                           benchAxis(kBenchTxPowersDbm);
+static_assert(kBenchSteps <= 256, "Link bench step index is one byte");
+
+TankControl::BenchCollector benchCollector;
+
+TankControl::RadioProfile benchProfile(const TankControl::BenchStep &step)
+{
+  TankControl::RadioProfile profile = kBaseRadioProfile;
+  profile.spreadingFactor = step.spreadingFactor;
+  profile.bandwidthHz = TankControl::bandwidthFromCode(step.bandwidthCode);
+  profile.codingRate = step.codingRate;
+  return profile;
+}
+
+// Probe spacing: at least the budget's share of airtime, plus a small gap.
+uint32_t benchProbePeriodUs(uint32_t airUs)
+{
+  uint32_t paced = static_cast<uint64_t>(airUs) * 1000 / CONFIG_AIRTIME_BUDGET_MS;
+  return max<uint32_t>(paced, airUs + 5000);
+}
+
+// Step index -> settings, fastest-changing axis last (power).
+TankControl::BenchStep benchStepAt(uint16_t runId, size_t index)
+{
+  TankControl::BenchStep step = {};
+  size_t rest = index;
+  step.txPowerDbm = kBenchTxPowersDbm[rest % benchAxis(kBenchTxPowersDbm)];
+  rest /= benchAxis(kBenchTxPowersDbm);
+  step.payloadSize = kBenchPayloadSizes[rest % benchAxis(kBenchPayloadSizes)];
+  rest /= benchAxis(kBenchPayloadSizes);
+  step.codingRate = kBenchCodingRates[rest % benchAxis(kBenchCodingRates)];
+  rest /= benchAxis(kBenchCodingRates);
+  step.bandwidthCode = TankControl::bandwidthCode(kBenchBandwidthsHz[rest % benchAxis(kBenchBandwidthsHz)]);
+  rest /= benchAxis(kBenchBandwidthsHz);
+  step.spreadingFactor = kBenchSpreadingFactors[rest];
+  step.runId = runId;
+  step.index = static_cast<uint8_t>(index);
+
+  uint32_t airUs = TankControl::timeOnAirUs(benchProfile(step), step.payloadSize);
+  uint32_t probes = kBenchStepAirMs * 1000 / airUs;
+  step.probes = static_cast<uint16_t>(constrain(probes, kBenchMinProbes, TankControl::kBenchMaxProbes));
+  uint64_t probeWindowUs = static_cast<uint64_t>(step.probes) * benchProbePeriodUs(airUs);
+  step.windowMs = kBenchSettleMs + static_cast<uint32_t>(probeWindowUs / 1000) + kBenchTailMs;
+  return step;
+}
+
+bool benchSend(const uint8_t *payload, size_t length, uint32_t *airUs = nullptr)
+{
+  LoRa.idle();
+  if (!LoRa.beginPacket())
+    return false;
+  radioAccess.loadPacket(payload, length);
+  uint32_t startUs = micros();
+  bool ok = LoRa.endPacket() == 1;
+  if (airUs)
+    *airUs = micros() - startUs;
+  return ok;
+}
+
+// Polls for one packet until deadlineUs. Returns its length (0 on timeout).
+size_t benchReceive(uint8_t *buffer, size_t capacity, uint32_t deadlineUs)
+{
+  while (static_cast<int32_t>(deadlineUs - micros()) > 0)
+  {
+    int size = LoRa.parsePacket();
+    if (size > 0)
+      return radioAccess.readPacket(buffer, capacity, size);
+    vTaskDelay(1);
+  }
+  return 0;
+}
+
+void waitUntilUs(uint32_t targetUs)
+{
+  while (static_cast<int32_t>(targetUs - micros()) > 1000)
+    vTaskDelay(1);
+  while (static_cast<int32_t>(targetUs - micros()) > 0)
+  {
+  }
+}
+
+void printBenchDistribution(const char *name, const int16_t *values, float scale)
+{
+  Serial.printf(",\"%s\":[", name);
+  for (size_t i = 0; i < 5; ++i)
+    Serial.printf(i ? ",%.2f" : "%.2f", values[i] * scale);
+  Serial.print("]");
+}
+
+void runBenchStep(const TankControl::BenchStep &step)
+{
+  uint8_t packet[255];
+  size_t length = TankControl::encodeBenchAnnounce(step, packet, sizeof(packet));
+  applyRadioProfile(kBaseRadioProfile);
+  LoRa.setTxPower(CONFIG_RADIO_OUTPUT_POWER);
+  if (!benchSend(packet, length))
+  {
+    Serial.printf("{\"event\":\"error\",\"step\":%u,\"reason\":\"announce\"}\n", step.index);
+    return;
+  }
+  uint32_t startUs = micros();
+
+  TankControl::RadioProfile profile = benchProfile(step);
+  applyRadioProfile(profile);
+  LoRa.setTxPower(step.txPowerDbm);
+  uint32_t modelAirUs = TankControl::timeOnAirUs(profile, step.payloadSize);
+  uint32_t periodUs = benchProbePeriodUs(modelAirUs);
+  uint32_t firstProbeUs = startUs + kBenchSettleMs * 1000;
+
+  uint16_t sent = 0;
+  uint64_t totalAirUs = 0;
+  uint32_t lastEndUs = firstProbeUs;
+  for (uint16_t i = 0; i < step.probes; ++i)
+  {
+    waitUntilUs(firstProbeUs + i * periodUs);
+    length = TankControl::encodeBenchProbe(step, i, packet, sizeof(packet));
+    uint32_t airUs = 0;
+    if (benchSend(packet, length, &airUs))
+    {
+      sent++;
+      totalAirUs += airUs;
+    }
+    lastEndUs = micros();
+  }
+
+  applyRadioProfile(kBaseRadioProfile);
+  LoRa.setTxPower(CONFIG_RADIO_OUTPUT_POWER);
+  uint32_t reportAirUs = TankControl::timeOnAirUs(kBaseRadioProfile, TankControl::kBenchReportSize);
+  uint32_t deadlineUs = startUs + step.windowMs * 1000 + reportAirUs + kBenchReportGuardMs * 1000;
+  TankControl::BenchReport report;
+  bool haveReport = false;
+  while (!haveReport)
+  {
+    length = benchReceive(packet, sizeof(packet), deadlineUs);
+    if (length == 0)
+      break;
+    haveReport = TankControl::decodeBenchReport(packet, length, report) && report.runId == step.runId &&
+                 report.index == step.index;
+  }
+
+  uint32_t probeWindowUs = lastEndUs - firstProbeUs;
+  Serial.printf("{\"run\":%u,\"step\":%u,\"sf\":%u,\"bwHz\":%u,\"cr\":%u,\"powerDbm\":%d,\"size\":%u,"
+                "\"sent\":%u,\"airUs\":%u,\"modelAirUs\":%u",
+                step.runId, step.index, step.spreadingFactor, static_cast<unsigned>(profile.bandwidthHz),
+                step.codingRate, step.txPowerDbm, step.payloadSize, sent,
+                static_cast<unsigned>(sent ? totalAirUs / sent : 0), static_cast<unsigned>(modelAirUs));
+  if (!haveReport)
+  {
+    Serial.println(",\"received\":null}");
+    return;
+  }
+  float per = sent ? 1.0f - static_cast<float>(min<uint16_t>(report.received, sent)) / sent : 1.0f;
+  float goodputBps = probeWindowUs ? report.received * step.payloadSize * 8 * 1e6f / probeWindowUs : 0;
+  int16_t snr[5];
+  for (size_t i = 0; i < 5; ++i)
+    snr[i] = report.snrQuarterDb[i];
+  Serial.printf(",\"received\":%u,\"duplicates\":%u,\"per\":%.4f,\"goodputBps\":%.1f", report.received,
+                report.duplicates, per, goodputBps);
+  printBenchDistribution("rssiDbm", report.rssiDbm, 1.0f);
+  printBenchDistribution("snrDb", snr, 0.25f);
+  Serial.println("}");
+}
+
+void runBenchSender()
+{
+  uint16_t runId = static_cast<uint16_t>(esp_random());
+  for (;;)
+  {
+    uint64_t estimateMs = 0;
+    for (size_t i = 0; i < kBenchSteps; ++i)
+      estimateMs += benchStepAt(runId, i).windowMs + 2 * kBenchReportGuardMs;
+    Serial.printf("{\"event\":\"start\",\"run\":%u,\"steps\":%u,\"estimatedS\":%u}\n", runId,
+                  static_cast<unsigned>(kBenchSteps), static_cast<unsigned>(estimateMs / 1000));
+    for (size_t i = 0; i < kBenchSteps; ++i)
+      runBenchStep(benchStepAt(runId, i));
+    Serial.printf("{\"event\":\"done\",\"run\":%u}\n", runId);
+    runId++;
+  }
+}
+
+// Receiver: waits on the base profile for an announce, follows the sender
+// to the step's profile for the announced window, then reports back.
+void runBenchReceiver()
+{
+  uint8_t packet[255];
+  Serial.println("{\"event\":\"listening\"}");
+  applyRadioProfile(kBaseRadioProfile);
+  for (;;)
+  {
+    size_t length = benchReceive(packet, sizeof(packet), micros() + 1000000);
+    TankControl::BenchStep step;
+    if (length == 0 || !TankControl::decodeBenchAnnounce(packet, length, step))
+      continue;
+    uint32_t windowEndUs = micros() + step.windowMs * 1000;
+    benchCollector.reset(step);
+    applyRadioProfile(benchProfile(step));
+
+    while ((length = benchReceive(packet, sizeof(packet), windowEndUs)) > 0)
+      benchCollector.addProbe(packet, length, static_cast<int16_t>(LoRa.packetRssi()), LoRa.packetSnr());
+
+    applyRadioProfile(kBaseRadioProfile);
+    length = benchCollector.encodeReport(packet, sizeof(packet));
+    bool sent = benchSend(packet, length);
+    Serial.printf("{\"run\":%u,\"step\":%u,\"sf\":%u,\"bwHz\":%u,\"cr\":%u,\"size\":%u,\"expected\":%u,"
+                  "\"received\":%u,\"duplicates\":%u,\"reportSent\":%s}\n",
+                  step.runId, step.index, step.spreadingFactor,
+                  static_cast<unsigned>(TankControl::bandwidthFromCode(step.bandwidthCode)), step.codingRate,
+                  step.payloadSize, step.probes, benchCollector.received(), benchCollector.duplicates(),
+                  sent ? "true" : "false");
+  }
+}
+
+void linkBenchTask(void *)
+{
+  if (MODE == 3)
+    runBenchSender();
+  else
+    runBenchReceiver();
+}
+
+bool beginLoRa()
+{
+  SPI.begin(RADIO_SCLK_PIN, RADIO_MISO_PIN, RADIO_MOSI_PIN, RADIO_CS_PIN);
+  LoRa.setPins(RADIO_CS_PIN, RADIO_RST_PIN, RADIO_DIO0_PIN);
+  LoRa.setSPIFrequency(CONFIG_RADIO_SPI_HZ);
+  radioAccess.begin(SPI, RADIO_CS_PIN, CONFIG_RADIO_SPI_HZ);
+
+#ifdef RADIO_TCXO_ENABLE
+  pinMode(RADIO_TCXO_ENABLE, OUTPUT);
+  digitalWrite(RADIO_TCXO_ENABLE, HIGH);
+#endif
+
+  if (!LoRa.begin(CONFIG_RADIO_FREQ * 1000000))
+  {
+    Serial.println("LoRa init failed. Check wiring.");
+    return false;
+  }
+
+  LoRa.setTxPower(CONFIG_RADIO_OUTPUT_POWER);
+  LoRa.enableCrc();
+  adaptiveRate.setTargets(CONFIG_ADR_TARGET_MARGIN_DB, CONFIG_ADR_MAX_LOSS_PERCENT);
+  applyRadioProfile(radioProfile);
+
+  Serial.printf("LoRa radio ready (TX). SF%u: frame %uus, trajectory %uus on air, budget %ums/s\n",
+                radioProfile.spreadingFactor,
+                static_cast<unsigned>(TankControl::timeOnAirUs(radioProfile, kWireFrameSize)),
+                static_cast<unsigned>(TankControl::timeOnAirUs(radioProfile, kWireTrajectorySize)),
+                static_cast<unsigned>(CONFIG_AIRTIME_BUDGET_MS));
+  if (kLbtEnabled)
+  {
+    uint32_t cadUs = TankControl::cadTimeUs(radioProfile);
+    Serial.printf("LBT: CAD %uus, worst added delay %uus (frame) / %uus (trajectory)\n", static_cast<unsigned>(cadUs),
+                  static_cast<unsigned>(TankControl::ListenBeforeTalk::worstDelayUs(
+                      cadUs, TankControl::timeOnAirUs(radioProfile, kWireFrameSize))),
+                  static_cast<unsigned>(TankControl::ListenBeforeTalk::worstDelayUs(
+                      cadUs, TankControl::timeOnAirUs(radioProfile, kWireTrajectorySize))));
+  }
+  return true;
+}
+
+void handleWebRoot()
+{
+  server.send_P(200, "text/html", indexPage);
+}
+
+// Optional ?vehicle= argument, 1..kFleetSize, default 1. Answers 400 and
+// returns false when it is out of range.
+bool webVehicle(uint8_t &vehicle)
+{
+  long value = server.hasArg("vehicle") ? server.arg("vehicle").toInt() : 1;
+  if (value < 1 || value > kFleetSize)
+  {
+    server.send(400, "application/json", "{\"error\":\"unknown vehicle\"}");
+    return false;
+  }
+  vehicle = static_cast<uint8_t>(value);
+  return true;
+}
+
+void handleWebCommand()
+{
+  if (!server.hasArg("action"))
+  {
+    server.send(400, "application/json", "{\"error\":\"missing action\"}");
+    return;
+  }
+  uint8_t vehicle = 1;
+  if (!webVehicle(vehicle))
+    return;
+
+  String action = server.arg("action");
+  action.toLowerCase();
+  TankControl::Command cmd = parseCommand(action);
+  VehicleCommandState &state = vehicleState(vehicle);
+  bool ok = true;
+
+  if (cmd == TankControl::Command::SetSpeed)
+  {
+    int left = server.hasArg("left") ? server.arg("left").toInt() : state.leftSpeed;
+    int right = server.hasArg("right") ? server.arg("right").toInt() : state.rightSpeed;
+    left = constrain(left, 0, 255);
+    right = constrain(right, 0, 255);
+    state.leftSpeed = static_cast<uint8_t>(left);
+    state.rightSpeed = static_cast<uint8_t>(right);
+    ok = sendLoRaFrame(vehicle, cmd, state.leftSpeed, state.rightSpeed);
+    if (ok)
+      state.lastState = "SPEED";
+  }
+  else
+  {
+    ok = sendLoRaFrame(vehicle, cmd, state.leftSpeed, state.rightSpeed);
+    if (ok)
+    {
+      state.lastCommandWasStop = cmd == TankControl::Command::Stop;
+      switch (cmd)
+      {
+      case TankControl::Command::Forward:
+        state.lastState = "FORWARD";
+        break;
+      case TankControl::Command::Backward:
+        state.lastState = "BACKWARD";
+        break;
+      case TankControl::Command::Left:
+        state.lastState = "LEFT";
+        break;
+      case TankControl::Command::Right:
+        state.lastState = "RIGHT";
+        break;
+      case TankControl::Command::Stop:
+        state.lastState = "STOP";
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  if (!ok)
+  {
+    server.send(500, "application/json", "{\"error\":\"lora tx queue full\"}");
+    return;
+  }
+
+  String body = "{\"vehicle\":";
+  body += vehicle;
+  body += ",\"state\":\"";
+  body += state.lastState;
+  body += "\"}";
+  server.send(200, "application/json", body);
+}
+
+void handleWebStopStats()
+{
+  String body = "{\"lastUs\":";
+  body += stopLatency.lastUs;
+  body += ",\"maxUs\":";
+  body += stopLatency.maxUs;
+  body += ",\"cacheHits\":";
+  body += stopLatency.cacheHits;
+  body += ",\"cacheMisses\":";
+  body += stopLatency.cacheMisses;
+  body += "}";
+  server.send(200, "application/json", body);
+}
+
+void handleWebTxStats()
+{
+  String body = "{\"depth\":";
+  body += txStats.depth;
+  body += ",\"maxDepth\":";
+  body += txStats.maxDepth;
+  body += ",\"sent\":";
+  body += txStats.sent;
+  body += ",\"failed\":";
+  body += txStats.failed;
+  body += ",\"dropped\":";
+  body += txStats.dropped;
+  body += ",\"preempted\":";
+  body += txStats.preempted;
+  body += ",\"lastTxDoneUs\":";
+  body += txStats.lastTxDoneUs;
+  body += ",\"maxTxDoneUs\":";
+  body += txStats.maxTxDoneUs;
+  body += ",\"lbt\":{\"enabled\":";
+  body += kLbtEnabled ? "true" : "false";
+  body += ",\"checks\":";
+  body += lbt.checks();
+  body += ",\"busy\":";
+  body += lbt.busy();
+  body += ",\"forced\":";
+  body += lbt.forced();
+  body += ",\"cadTimeouts\":";
+  body += lbtCadTimeouts;
+  body += ",\"lastDelayUs\":";
+  body += lbt.lastDelayUs();
+  body += ",\"meanDelayUs\":";
+  body += lbt.meanDelayUs();
+  body += ",\"maxDelayUs\":";
+  body += lbt.maxDelayUs();
+  body += ",\"boundUs\":";
+  body += TankControl::ListenBeforeTalk::worstDelayUs(TankControl::cadTimeUs(radioProfile), TankControl::timeOnAirUs(radioProfile, kWireTrajectorySize));
+  body += "}}";
+  server.send(200, "application/json", body);
+}
+
+void handleWebPipelineStats()
+{
+  uint32_t handled = pipelineStats.handled;
+  String body = "{\"radioCpu\":";
+  body += radioLoad.percent;
+  body += ",\"networkCpu\":";
+  body += networkLoad.percent;
+  body += ",\"ringDepth\":";
+  body += static_cast<uint32_t>(radioRing.size());
+  body += ",\"ringFull\":";
+  body += pipelineStats.postFailed;
+  body += ",\"lastQueueUs\":";
+  body += pipelineStats.lastQueueUs;
+  body += ",\"maxQueueUs\":";
+  body += pipelineStats.maxQueueUs;
+  body += ",\"avgQueueUs\":";
+  body += static_cast<uint32_t>(handled ? pipelineStats.totalQueueUs / handled : 0);
+  body += ",\"deadlineStops\":";
+  body += pipelineStats.deadlineStops;
+  body += ",\"coalesced\":";
+  body += pipelineStats.coalesced;
+  body += ",\"budgetDeferred\":";
+  body += pipelineStats.budgetDeferred;
+  body += ",\"airtimeUsedUs\":";
+  body += airtimeBudget.usedLastSecondUs();
+  body += ",\"airtimeBudgetUs\":";
+  body += airtimeBudget.budgetUs();
+  body += "}";
+  server.send(200, "application/json", body);
+}
+
+void handleWebLinkStats()
+{
+  const TankControl::LatencyHistogram &rtt = ackTracker.rtt();
+  String body = "{\"sent\":";
+  body += ackTracker.sent();
+  body += ",\"acked\":";
+  body += ackTracker.delivered();
+  body += ",\"lost\":";
+  body += ackTracker.lost();
+  body += ",\"inFlight\":";
+  body += static_cast<uint32_t>(ackTracker.inFlight());
+  body += ",\"unmatched\":";
+  body += ackTracker.unmatched();
+  body += ",\"badFrames\":";
+  body += linkTelemetry.badFrames;
+  body += ",\"rttUs\":{\"p50\":";
+  body += rtt.percentileUs(50);
+  body += ",\"p90\":";
+  body += rtt.percentileUs(90);
+  body += ",\"p99\":";
+  body += rtt.percentileUs(99);
+  body += ",\"min\":";
+  body += rtt.minUs();
+  body += ",\"mean\":";
+  body += rtt.meanUs();
+  body += ",\"max\":";
+  body += rtt.maxUs();
+  body += "},\"rttHistogram\":[";
+  for (size_t i = 0; i < TankControl::LatencyHistogram::kBuckets; ++i)
+  {
+    if (i)
+      body += ",";
+    body += rtt.bucket(i);
+  }
+  body += "],\"lossBursts\":[";
+  for (size_t i = 0; i < TankControl::AckTracker::kBurstBuckets; ++i)
+  {
+    if (i)
+      body += ",";
+    body += ackTracker.lossBursts(i);
+  }
+  body += "],\"ackRssi\":";
+  body += linkTelemetry.localRssiDbm;
+  body += ",\"ackSnr\":";
+  body += linkTelemetry.localSnrDb;
+  body += ",\"rxRssi\":";
+  body += linkTelemetry.remoteRssiDbm;
+  body += ",\"rxSnr\":";
+  body += linkTelemetry.remoteSnrQuarterDb / 4.0f;
+  body += ",\"leftMotor\":";
+  body += linkTelemetry.leftMotor;
+  body += ",\"rightMotor\":";
+  body += linkTelemetry.rightMotor;
+  body += ",\"status\":";
+  body += linkTelemetry.status;
+  body += ",\"adr\":{\"enabled\":";
+  body += CONFIG_ADR_ENABLE ? "true" : "false";
+  body += ",\"sf\":";
+  body += radioProfile.spreadingFactor;
+  body += ",\"bwHz\":";
+  body += radioProfile.bandwidthHz;
+  body += ",\"marginDb\":";
+  body += adaptiveRate.lastMarginDb();
+  body += ",\"proposals\":";
+  body += adrStats.proposals;
+  body += ",\"switches\":";
+  body += adrStats.switches;
+  body += ",\"rejected\":";
+  body += adrStats.rejected;
+  body += ",\"reverts\":";
+  body += adrStats.reverts;
+  body += ",\"fallbacks\":";
+  body += adrStats.fallbacks;
+  body += "},\"heartbeat\":{\"periodMs\":";
+  body += kHeartbeatMs;
+  body += ",\"sent\":";
+  body += heartbeatStats.sent;
+  body += ",\"failed\":";
+  body += heartbeatStats.failed;
+  body += ",\"deferred\":";
+  body += heartbeatStats.deferred;
+  body += "}}";
+  server.send(200, "application/json", body);
+}
+
+void handleWebFleetStats()
+{
+  String body = "{\"vehicles\":";
+  body += kFleetSize;
+  body += ",\"slotUs\":";
+  body += fleetLimits.slotUs;
+  body += ",\"roundUs\":";
+  body += fleetLimits.roundUs;
+  body += ",\"worstLatencyUs\":";
+  body += fleetLimits.worstLatencyUs;
+  body += ",\"perVehicleRateHz\":";
+  body += fleetLimits.perVehicleRateMilliHz / 1000.0f;
+  body += ",\"capacity\":";
+  body += fleetLimits.maxVehiclesForTarget;
+  body += ",\"latencyTargetMs\":";
+  body += CONFIG_FLEET_LATENCY_TARGET_MS;
+  body += ",\"perVehicle\":[";
+  for (uint8_t i = 0; i < kFleetSize; ++i)
+  {
+    if (i)
+      body += ",";
+    body += "{\"id\":";
+    body += i + 1;
+    body += ",\"state\":\"";
+    body += vehicleStates[i].lastState;
+    body += "\",\"served\":";
+    body += fleetStats.served[i];
+    body += ",\"lastWaitUs\":";
+    body += fleetStats.lastWaitUs[i];
+    body += ",\"maxWaitUs\":";
+    body += fleetStats.maxWaitUs[i];
+    body += "}";
+  }
+  body += "]}";
+  server.send(200, "application/json", body);
+}
+
+void handleWebDrive()
+{
+  if (!server.hasArg("left") || !server.hasArg("right"))
+  {
+    server.send(400, "application/json", "{\"error\":\"missing left/right\"}");
+    return;
+  }
+
+  uint8_t vehicle = 1;
+  if (!webVehicle(vehicle))
+    return;
+
+  int8_t left = velocityFromPercent(server.arg("left").toInt());
+  int8_t right = velocityFromPercent(server.arg("right").toInt());
+  if (!sendDriveFrame(vehicle, left, right))
+  {
+    server.send(500, "application/json", "{\"error\":\"lora tx queue full\"}");
+    return;
+  }
+
+  String body = "{\"vehicle\":";
+  body += vehicle;
+  body += ",\"state\":\"";
+  body += vehicleState(vehicle).lastState;
+  body += "\"}";
+  server.send(200, "application/json", body);
+}
+
+// One vehicle's command from the status server, read from either encoding.
+struct ServerCommand
+{
+  TankControl::Command command = TankControl::Command::Stop;
+  const char *name = "STOP";
+  int speedness = 0;
+  int left = 0;
+  int right = 0;
+  uint32_t trajectoryId = 0;
+  size_t segmentCount = 0;
+  TankControl::TrajectorySegment segments[TankControl::kMaxTrajectorySegments];
+};
+
+void addServerSegment(ServerCommand &command, TankControl::Command segmentCommand, int speedness, long durationMs)
+{
+  if (command.segmentCount == TankControl::kMaxTrajectorySegments)
+    return;
+  uint8_t pwm = map(constrain(speedness, 0, 100), 0, 100, 0, 255);
+  TankControl::TrajectorySegment &segment = command.segments[command.segmentCount++];
+  segment.command = static_cast<uint8_t>(segmentCommand);
+  segment.leftSpeed = pwm;
+  segment.rightSpeed = pwm;
+  segment.durationMs = constrain(durationMs, 0L, 65535L);
+}
+
+// JSON command object from GET /status or a push event: {command,
+// speedness, left, right, segments, trajectoryId}.
+void readServerCommand(JsonVariantConst entry, ServerCommand &command)
+{
+  command.name = entry["command"] | "STOP";
+  command.command = commandFromName(command.name);
+  command.speedness = entry["speedness"] | 0;
+  command.left = entry["left"] | 0;
+  command.right = entry["right"] | 0;
+  command.trajectoryId = entry["trajectoryId"] | 0UL;
+  command.segmentCount = 0;
+  JsonArrayConst segmentsJson = entry["segments"];
+  for (JsonVariantConst segmentJson : segmentsJson)
+  {
+    addServerSegment(command, commandFromName(segmentJson["command"] | "STOP"), segmentJson["speedness"] | 0,
+                     segmentJson["ms"] | 0);
+  }
+}
+
+// Vehicle record from GET /status.bin: fixed offsets, no lookups.
+void readServerCommand(const TankControl::StatusBinaryReader &reader, ServerCommand &command)
+{
+  const TankControl::StatusBinaryVehicle &vehicle = reader.vehicle();
+  command.command = commandFromCode(vehicle.get<TankControl::kStatusCommandField>());
+  command.name = commandName(command.command);
+  command.speedness = vehicle.get<TankControl::kStatusSpeednessField>();
+  command.left = vehicle.get<TankControl::kStatusLeftField>();
+  command.right = vehicle.get<TankControl::kStatusRightField>();
+  command.trajectoryId = vehicle.get<TankControl::kStatusTrajectoryIdField>();
+  command.segmentCount = 0;
+  uint8_t segments = vehicle.get<TankControl::kStatusSegmentCountField>();
+  for (uint8_t i = 0; i < segments; ++i)
+  {
+    TankControl::StatusBinarySegment segment = reader.segment(i);
+    addServerSegment(command, commandFromCode(segment.get<TankControl::kStatusSegmentCommandField>()),
+                     segment.get<TankControl::kStatusSegmentSpeednessField>(),
+                     segment.get<TankControl::kStatusSegmentDurationField>());
+  }
+}
+
+// Sends one vehicle's command from the status server.
+void applyServerCommand(uint8_t vehicle, const ServerCommand &command)
+{
+  VehicleCommandState &state = vehicleState(vehicle);
+  int speedness = constrain(command.speedness, 0, 100);
+  uint8_t speed = map(speedness, 0, 100, 0, 255);
+
+  // Any other command ends the trajectory on the server too, so whatever
+  // id comes next is a new trajectory, even one the server reused.
+  if (command.command != TankControl::Command::Trajectory)
+    state.lastTrajectoryId = 0;
+
+  if (command.command == TankControl::Command::Drive)
+  {
+    if (sendDriveFrame(vehicle, velocityFromPercent(command.left), velocityFromPercent(command.right)))
+    {
+      Serial.printf("From server: vehicle %u DRIVE left=%d%% right=%d%%\n", vehicle, command.left, command.right);
+    }
+    return;
+  }
+
+  if (command.command == TankControl::Command::Trajectory)
+  {
+    // The server keeps returning the same trajectory until a new one is
+    // posted; only send each trajectory id once.
+    if (command.trajectoryId != state.lastTrajectoryId &&
+        sendLoRaTrajectory(vehicle, command.segments, command.segmentCount))
+    {
+      state.lastTrajectoryId = command.trajectoryId;
+      state.lastState = "TRAJECTORY";
+      state.lastCommandWasStop = false;
+    }
+    return;
+  }
+
+  state.leftSpeed = speed;
+  state.rightSpeed = speed;
+  state.lastState = command.name;
+  state.lastCommandWasStop = (command.command == TankControl::Command::Stop);
+
+  if (sendLoRaFrame(vehicle, command.command, speed, speed))
+  {
+    Serial.printf("From server: vehicle %u %s @ %d%%\n", vehicle, command.name, speedness);
+  }
+}
+
+// Largest status document accepted, from a poll or a push event. An
+// 8-segment trajectory is about 450 bytes and vehicle 1 appears twice (top
+// level and in "vehicles").
+const size_t kStatusBodyCapacity = 768 * (kFleetSize + 1);
+
+// Documents are parsed in place (zero-copy): strings stay in the body
+// buffer, so the document only needs its slots. A command object has at
+// most 7 members and kMaxTrajectorySegments segments of 3; the top level
+// adds "vehicles", "version" and "clickToServerMs".
+const size_t kStatusCommandJsonSize = JSON_OBJECT_SIZE(7) + JSON_ARRAY_SIZE(TankControl::kMaxTrajectorySegments) +
+                                      TankControl::kMaxTrajectorySegments * JSON_OBJECT_SIZE(3);
+const size_t kStatusJsonSize = (kFleetSize + 1) * kStatusCommandJsonSize + JSON_OBJECT_SIZE(2) +
+                               JSON_ARRAY_SIZE(kFleetSize);
+
+// Static: one command object per vehicle would not fit the task stack.
+// Shared by the poll and the push channel, which both run on networkTask.
+StaticJsonDocument<kStatusJsonSize> statusDoc;
+// Only the fields applyServerCommand() and the version check read; the
+// parser skips everything else without storing it. Built once in setup().
+StaticJsonDocument<512> statusFilter;
+
+void addCommandFilter(JsonVariant entry)
+{
+  entry["command"] = true;
+  entry["speedness"] = true;
+  entry["left"] = true;
+  entry["right"] = true;
+  entry["trajectoryId"] = true;
+  JsonVariant segment = entry["segments"][0];
+  segment["command"] = true;
+  segment["speedness"] = true;
+  segment["ms"] = true;
+}
+
+void buildStatusFilter()
+{
+  statusFilter.clear();
+  addCommandFilter(statusFilter.as<JsonVariant>());
+  JsonVariant vehicle = statusFilter["vehicles"][0];
+  vehicle["id"] = true;
+  addCommandFilter(vehicle);
+  statusFilter["version"] = true;
+  statusFilter["clickToServerMs"] = true;
+}
+
+enum class StatusApply
+{
+  Invalid,
+  Unchanged,
+  Applied
+};
+
+// Change-only delivery: the version of the last status document applied in
+// full. A document with the same version is not sent again. After a frame
+// was lost on air the next poll asks for the whole state again (see
+// startStatusPoll), so a lost command is still repaired.
+bool haveAppliedVersion = false;
+uint32_t appliedVersion = 0;
+
+struct StatusPollStats
+{
+  uint32_t changed = 0;
+  uint32_t unchanged = 0;
+  uint32_t notModified = 0;
+  uint32_t resyncs = 0;
+};
+StatusPollStats statusPollStats;
+
+// A status document decoded from either encoding, before anything is
+// sent. Static: networkTask only, and too big for its stack in a fleet.
+struct StatusUpdate
+{
+  bool versioned = false;
+  uint32_t version = 0;
+  // Fleet form: a vehicle the server does not list is stopped.
+  bool fleet = false;
+  bool listed[kFleetSize] = {};
+  ServerCommand commands[kFleetSize];
+};
+StatusUpdate statusUpdate;
+// Decode time per status document: parse plus reading every vehicle's
+// command, nothing sent yet.
+TankControl::HttpPhaseStats statusDecodeStats;
+uint32_t lastStatusAgeMs = 0;
+
+void resetStatusUpdate(StatusUpdate &update)
+{
+  update.versioned = false;
+  update.version = 0;
+  update.fleet = false;
+  for (uint8_t i = 0; i < kFleetSize; ++i)
+    update.listed[i] = false;
+}
+
+// json is parsed in place and statusDoc points into it, so it must stay
+// untouched until statusDoc is done with; nothing here allocates.
+bool decodeStatusJson(char *json, size_t length, StatusUpdate &update)
+{
+  DeserializationError error =
+      deserializeJson(statusDoc, json, length, DeserializationOption::Filter(statusFilter));
+  if (error)
+  {
+    Serial.printf("JSON parse failed: %s\n", error.c_str());
+    return false;
+  }
+  resetStatusUpdate(update);
+  JsonVariantConst versionJson = statusDoc["version"];
+  update.versioned = !versionJson.isNull();
+  update.version = versionJson | 0UL;
+
+  // Fleet servers list {id, ...} per vehicle under "vehicles". The
+  // top-level command is the single-vehicle form and drives vehicle 1.
+  JsonArrayConst vehicles = statusDoc["vehicles"];
+  if (vehicles.isNull())
+  {
+    update.listed[0] = true;
+    readServerCommand(statusDoc.as<JsonVariantConst>(), update.commands[0]);
+    return true;
+  }
+  update.fleet = true;
+  for (JsonVariantConst entry : vehicles)
+  {
+    int id = entry["id"] | 0;
+    if (id < 1 || id > kFleetSize || update.listed[id - 1])
+      continue;
+    update.listed[id - 1] = true;
+    readServerCommand(entry, update.commands[id - 1]);
+  }
+  return true;
+}
+
+bool decodeStatusBinary(const uint8_t *data, size_t length, StatusUpdate &update)
+{
+  TankControl::StatusBinaryReader reader;
+  if (!reader.begin(data, length))
+  {
+    Serial.printf("Bad /status.bin document (%u bytes)\n", static_cast<unsigned>(length));
+    return false;
+  }
+  resetStatusUpdate(update);
+  update.versioned = true;
+  update.version = reader.version();
+  update.fleet = true;
+  lastStatusAgeMs = reader.ageMs();
+  while (reader.next())
+  {
+    uint8_t id = reader.vehicle().get<TankControl::kStatusVehicleIdField>();
+    if (id < 1 || id > kFleetSize || update.listed[id - 1])
+      continue;
+    update.listed[id - 1] = true;
+    readServerCommand(reader, update.commands[id - 1]);
+  }
+  return true;
+}
 
-  if (MODE == 1)
+// Sends a decoded document to every vehicle unless its version was applied
+// already. Documents without a version (older servers) are always applied.
+StatusApply applyStatusUpdate(const StatusUpdate &update)
+{
+  networkOkMs.store(millis(), std::memory_order_release);
+  // Versions only go backwards when the server restarted and counts from 0
+  // again; trajectory ids it hands out from then on may repeat old ones.
+  if (update.versioned && update.version < appliedVersion)
   {
-    Serial.println("Starting in AP + Web UI mode (MODE 1)");
-    WiFi.mode(WIFI_AP);
-    if (WiFi.softAP("TankController", "tank12345"))
-    {
-      Serial.print("SoftAP ready. SSID: TankController, IP: ");
-      Serial.println(WiFi.softAPIP());
-    }
-    else
+    Serial.printf("Status version went back (%u -> %u): server restarted\n", static_cast<unsigned>(appliedVersion),
+                  static_cast<unsigned>(update.version));
+    for (VehicleCommandState &state : vehicleStates)
+      state.lastTrajectoryId = 0;
+    haveAppliedVersion = false;
+  }
+  if (update.versioned && haveAppliedVersion && update.version == appliedVersion)
+  {
+    statusPollStats.unchanged++;
+    return StatusApply::Unchanged;
+  }
+  uint32_t postFailedBefore = pipelineStats.postFailed;
+
+  for (uint8_t i = 0; i < kFleetSize; ++i)
+  {
+    if (update.listed[i])
+      applyServerCommand(i + 1, update.commands[i]);
+    else if (update.fleet)
     {
-      Serial.println("Failed to start SoftAP.");
+      vehicleStates[i].lastTrajectoryId = 0;
+      sendVehicleStop(i + 1);
     }
+  }
+  statusPollStats.changed++;
+  // A command that did not fit the radio ring was not sent; leave the
+  // version unrecorded so the next response applies it again.
+  haveAppliedVersion = update.versioned && pipelineStats.postFailed == postFailedBefore;
+  appliedVersion = update.version;
+  return StatusApply::Applied;
+}
 
-    server.on("/", HTTP_GET, handleWebRoot);
-    server.on("/cmd", HTTP_POST, handleWebCommand);
-    server.onNotFound([]()
-                      { server.send(404, "application/json", "{\"error\":\"not found\"}"); });
-    server.begin();
-    Serial.println("Web UI ready at http://" + WiFi.softAPIP().toString());
+// GET /status body or push event.
+StatusApply applyStatusJson(char *json, size_t length)
+{
+  uint32_t decodeStartUs = micros();
+  bool decoded = decodeStatusJson(json, length, statusUpdate);
+  statusDecodeStats.record(micros() - decodeStartUs);
+  return decoded ? applyStatusUpdate(statusUpdate) : StatusApply::Invalid;
+}
+
+// GET /status.bin body.
+StatusApply applyStatusBinary(const uint8_t *data, size_t length)
+{
+  uint32_t decodeStartUs = micros();
+  bool decoded = decodeStatusBinary(data, length, statusUpdate);
+  statusDecodeStats.record(micros() - decodeStartUs);
+  return decoded ? applyStatusUpdate(statusUpdate) : StatusApply::Invalid;
+}
+
+// Long-poll hold: the server answers at once when the version moves, else
+// with 304 after this long. Kept below kNetworkStopDeadlineMs, since a 304
+// is what proves the server reachable while nothing changes.
+const uint32_t kLongPollHoldMs = 1000;
+// Polling GET /status.bin rather than GET /status.
+bool statusBinary = CONFIG_STATUS_BINARY;
+char pollBody[kStatusBodyCapacity];
+size_t pollBodyLength = 0;
+uint32_t pollLostMark = 0;
+
+// Starts the next GET /status. With a version applied it is a long poll
+// for anything newer; after a frame was reported lost on air it is a plain
+// GET, so the current state is applied and sent again.
+void startStatusPoll()
+{
+  char query[32] = "";
+  uint32_t holdMs = 0;
+  uint32_t lost = ackTracker.lost();
+  if (lost != pollLostMark)
+  {
+    pollLostMark = lost;
+    if (haveAppliedVersion)
+      statusPollStats.resyncs++;
+    haveAppliedVersion = false;
   }
-  else if (MODE == 2)
+  if (haveAppliedVersion)
   {
-    Serial.println("Starting in WiFi Client + Server GET mode (MODE 2)");
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(kStaSsid, kStaPassword);
+    snprintf(query, sizeof(query), "since=%u&wait=%u", static_cast<unsigned>(appliedVersion),
+             static_cast<unsigned>(kLongPollHoldMs));
+    holdMs = kLongPollHoldMs;
+  }
+  int httpCode = statusClient.start(query, holdMs);
+  if (httpCode != TankControl::StatusClient::kPending)
+  {
+    Serial.printf("HTTP failed: %d\n", httpCode);
+    sendStopCommand();
+  }
+}
 
-    Serial.print("Connecting to ");
-    Serial.println(kStaSsid);
+// Completes the poll in flight once its response is in. 304 means the
+// version did not move during the hold.
+void serviceStatusPoll()
+{
+  int httpCode = statusClient.service(pollBody, sizeof(pollBody), pollBodyLength);
+  if (httpCode == TankControl::StatusClient::kPending)
+    return;
 
-    unsigned long startAttemptTime = millis();
-    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < 10000)
-    {
-      delay(500);
-      Serial.print(".");
-    }
+  if (httpCode == 200)
+  {
+    StatusApply result = statusBinary
+                             ? applyStatusBinary(reinterpret_cast<const uint8_t *>(pollBody), pollBodyLength)
+                             : applyStatusJson(pollBody, pollBodyLength);
+    if (result == StatusApply::Invalid)
+      sendStopCommand();
+  }
+  else if (httpCode == 404 && statusBinary)
+  {
+    // An API without /status.bin: poll JSON from now on. The STOP deadline
+    // still covers the gap.
+    Serial.printf("No %s, polling %s\n", kServerBinaryUrl, kServerUrl);
+    statusBinary = false;
+    statusClient.begin(kServerUrl);
+  }
+  else if (httpCode == 304)
+  {
+    statusPollStats.notModified++;
+    networkOkMs.store(millis(), std::memory_order_release);
+  }
+  else
+  {
+    Serial.printf("HTTP failed: %d\n", httpCode);
+    sendStopCommand();
+  }
+}
 
-    if (WiFi.status() == WL_CONNECTED)
+#ifdef CONFIG_STATUS_BENCH
+// A worst-case status document: vehicle 1 on a full trajectory, the rest
+// driving. Returns its length, or 0 if it does not fit.
+size_t formatBenchStatus(char *out, size_t capacity)
+{
+  char segments[512];
+  size_t used = 0;
+  segments[used++] = '[';
+  for (size_t i = 0; i < TankControl::kMaxTrajectorySegments; ++i)
+  {
+    used += snprintf(segments + used, sizeof(segments) - used, "%s{\"command\":\"%s\",\"speedness\":%u,\"ms\":%u}",
+                     i ? "," : "", i % 2 ? "LEFT" : "FORWARD", static_cast<unsigned>(60 + 5 * i),
+                     static_cast<unsigned>(500 + 100 * i));
+  }
+  snprintf(segments + used, sizeof(segments) - used, "]");
+
+  int length = snprintf(out, capacity,
+                        "{\"command\":\"TRAJECTORY\",\"speedness\":0,\"segments\":%s,\"trajectoryId\":7,"
+                        "\"vehicles\":[{\"id\":1,\"command\":\"TRAJECTORY\",\"speedness\":0,\"segments\":%s,"
+                        "\"trajectoryId\":7}",
+                        segments, segments);
+  for (uint8_t id = 2; id <= kFleetSize && length > 0 && static_cast<size_t>(length) < capacity; ++id)
+  {
+    length += snprintf(out + length, capacity - length,
+                       ",{\"id\":%u,\"command\":\"DRIVE\",\"speedness\":50,\"left\":40,\"right\":60}", id);
+  }
+  if (length > 0 && static_cast<size_t>(length) < capacity)
+    length += snprintf(out + length, capacity - length, "],\"version\":42}");
+  return length > 0 && static_cast<size_t>(length) < capacity ? static_cast<size_t>(length) : 0;
+}
+
+// The same document as GET /status.bin would send it.
+size_t formatBenchStatusBinary(uint8_t *out, size_t capacity)
+{
+  TankControl::StatusBinaryWriter writer(out, capacity);
+  bool ok = writer.begin(42, 0) && writer.addVehicle(1, TankControl::Command::Trajectory, 0, 0, 0, 7);
+  for (size_t i = 0; ok && i < TankControl::kMaxTrajectorySegments; ++i)
+  {
+    ok = writer.addSegment(i % 2 ? TankControl::Command::Left : TankControl::Command::Forward,
+                           static_cast<uint8_t>(60 + 5 * i), static_cast<uint16_t>(500 + 100 * i));
+  }
+  for (uint8_t id = 2; ok && id <= kFleetSize; ++id)
+    ok = writer.addVehicle(id, TankControl::Command::Drive, 50, 40, 60, 0);
+  return ok ? writer.length() : 0;
+}
+
+// Per-poll cost of turning a /status body into a JsonDocument: the old
+// path (body copied into a String, parsed in full with every string
+// copied into the document) against the current one (body in a fixed
+// buffer, parsed in place through statusFilter). Heap is the free-heap
+// drop while the body is held, i.e. what each poll allocated; the
+// current path must show 0, before and after the loop alike. Then the
+// whole decode a poll does, down to per-vehicle commands, for the JSON
+// body against the GET /status.bin body of the same document.
+void runStatusBenchmark()
+{
+  static constexpr uint32_t kIterations = 200;
+  static char sample[kStatusBodyCapacity];
+  static StaticJsonDocument<kStatusJsonSize + 1024> legacyDoc;
+  size_t length = formatBenchStatus(sample, sizeof(sample));
+  if (length == 0)
+  {
+    Serial.println("Status bench: sample does not fit kStatusBodyCapacity");
+    return;
+  }
+
+  uint32_t legacyHeap = 0;
+  DeserializationError legacyError;
+  uint32_t cycles = 0;
+  for (uint32_t i = 0; i < kIterations; ++i)
+  {
+    uint32_t freeBefore = ESP.getFreeHeap();
+    uint32_t start = ESP.getCycleCount();
+    String body(sample);
+    legacyError = deserializeJson(legacyDoc, body);
+    cycles += ESP.getCycleCount() - start;
+    uint32_t held = freeBefore - ESP.getFreeHeap();
+    if (held > legacyHeap)
+      legacyHeap = held;
+  }
+  uint32_t legacyUs = cycles / ESP.getCpuFreqMHz() / kIterations;
+
+  uint32_t heapAtStart = ESP.getFreeHeap();
+  uint32_t currentHeap = 0;
+  DeserializationError currentError;
+  cycles = 0;
+  for (uint32_t i = 0; i < kIterations; ++i)
+  {
+    uint32_t freeBefore = ESP.getFreeHeap();
+    uint32_t start = ESP.getCycleCount();
+    // The socket read refills the buffer every poll; the in-place parse
+    // overwrites it.
+    memcpy(pollBody, sample, length + 1);
+    currentError = deserializeJson(statusDoc, pollBody, length, DeserializationOption::Filter(statusFilter));
+    cycles += ESP.getCycleCount() - start;
+    uint32_t held = freeBefore - ESP.getFreeHeap();
+    if (held > currentHeap)
+      currentHeap = held;
+  }
+  uint32_t currentUs = cycles / ESP.getCpuFreqMHz() / kIterations;
+  int32_t heapDrift = static_cast<int32_t>(heapAtStart - ESP.getFreeHeap());
+
+  bool jsonOk = true;
+  cycles = 0;
+  for (uint32_t i = 0; i < kIterations; ++i)
+  {
+    uint32_t start = ESP.getCycleCount();
+    memcpy(pollBody, sample, length + 1);
+    jsonOk = decodeStatusJson(pollBody, length, statusUpdate) && jsonOk;
+    cycles += ESP.getCycleCount() - start;
+  }
+  uint32_t jsonDecodeUs = cycles / ESP.getCpuFreqMHz() / kIterations;
+
+  static uint8_t binary[TankControl::statusBinaryCapacity(kFleetSize)];
+  size_t binaryLength = formatBenchStatusBinary(binary, sizeof(binary));
+  bool binaryOk = binaryLength > 0;
+  cycles = 0;
+  for (uint32_t i = 0; binaryOk && i < kIterations; ++i)
+  {
+    uint32_t start = ESP.getCycleCount();
+    memcpy(pollBody, binary, binaryLength);
+    binaryOk = decodeStatusBinary(reinterpret_cast<const uint8_t *>(pollBody), binaryLength, statusUpdate);
+    cycles += ESP.getCycleCount() - start;
+  }
+  uint32_t binaryDecodeUs = cycles / ESP.getCpuFreqMHz() / kIterations;
+
+  Serial.printf("Status bench: %u-byte status, %u runs\n", static_cast<unsigned>(length),
+                static_cast<unsigned>(kIterations));
+  Serial.printf("  String + full parse:     %uus/poll heap=%uB/poll doc=%uB %s\n", legacyUs,
+                static_cast<unsigned>(legacyHeap), static_cast<unsigned>(legacyDoc.memoryUsage()),
+                legacyError.c_str());
+  Serial.printf("  buffer + in-place filter: %uus/poll heap=%uB/poll doc=%u/%uB %s, heap drift %dB\n", currentUs,
+                static_cast<unsigned>(currentHeap), static_cast<unsigned>(statusDoc.memoryUsage()),
+                static_cast<unsigned>(kStatusJsonSize), currentError.c_str(), static_cast<int>(heapDrift));
+  Serial.printf("  to commands: JSON %uB %uus/poll%s | /status.bin %uB %uus/poll%s\n",
+                static_cast<unsigned>(length), jsonDecodeUs, jsonOk ? "" : " FAILED",
+                static_cast<unsigned>(binaryLength), binaryDecodeUs, binaryOk ? "" : " FAILED");
+  pollBodyLength = 0;
+}
+#endif
+
+// === PUSH CHANNEL (MODE 2) ===
+const bool kPushEnabled = CONFIG_PUSH_ENABLE;
+// Poll period while the push stream is live: a resync and fallback only.
+const unsigned long kPushPollIntervalMs = 2000;
+// Opening the stream blocks networkTask for up to this long, so it has to
+// leave room for the poll that proves the server reachable.
+const uint32_t kPushConnectTimeoutMs = 250;
+static_assert(kPushConnectTimeoutMs + kLongPollHoldMs < kNetworkStopDeadlineMs,
+              "a push connect attempt must not trip the network STOP deadline");
+TankControl::EventStreamClient<kStatusBodyCapacity> pushChannel;
+
+struct PushStats
+{
+  uint32_t applied = 0;
+  uint32_t unchanged = 0;
+  uint32_t badEvents = 0;
+  uint32_t lastVersion = 0;
+  int32_t lastClickToServerMs = -1;
+  uint32_t lastParseUs = 0;
+};
+PushStats pushStats;
+
+// Applies every status event that has arrived. The server pings the stream
+// every 500 ms, so while it is live it also proves the server reachable
+// for the STOP deadline.
+void servicePushChannel()
+{
+  while (pushChannel.service())
+  {
+    auto &event = pushChannel.events();
+    if (!event.isEvent("status"))
+      continue;
+    pushEventRxUs = micros();
+    applyingPush = true;
+    StatusApply result = applyStatusJson(event.data(), event.dataLength());
+    applyingPush = false;
+    if (result == StatusApply::Invalid)
     {
-      Serial.println("\nWiFi connected!");
-      Serial.print("IP: ");
-      Serial.println(WiFi.localIP());
-      wasConnected = true;
+      pushStats.badEvents++;
+      continue;
     }
-    else
+    if (result == StatusApply::Unchanged)
     {
-      Serial.println("\nFailed to connect to WiFi. Will retry in loop.");
-      sendStopCommand();
+      pushStats.unchanged++;
+      continue;
     }
+    pushStats.applied++;
+    pushStats.lastParseUs = micros() - pushEventRxUs;
+    pushStats.lastVersion = statusUpdate.version;
+    pushStats.lastClickToServerMs = statusDoc["clickToServerMs"] | -1;
+    Serial.printf("Push: version %u applied in %uus\n", static_cast<unsigned>(pushStats.lastVersion),
+                  static_cast<unsigned>(pushStats.lastParseUs));
   }
-  else
+  if (pushChannel.live())
   {
-    Serial.println("Invalid MODE. Must be 1 or 2.");
-    while (true)
-      delay(1000);
+    // The last ping, not now: the STOP deadline runs from when the server
+    // was last heard, and a newer good poll must not be moved back.
+    uint32_t heardMs = pushChannel.lastActivityMs();
+    if (static_cast<int32_t>(heardMs - networkOkMs.load(std::memory_order_acquire)) > 0)
+      networkOkMs.store(heardMs, std::memory_order_release);
   }
 }
 
-// === LOOP ===
-void loop()
+// End to end from the frontend click to the frame reaching the TX queue:
+// click to server (half the frontend's last POST round trip, timed on its
+// own clock), server to controller (estimated as half the poll's
+// request-to-first-byte time) and event arrival to radio dispatch (measured
+// here). No leg compares two machines' clocks.
+void logPushStats()
+{
+  uint32_t dispatched = pipelineStats.pushDispatched;
+  uint32_t networkUs = statusClient.firstByteStats().meanUs() / 2;
+  int32_t endToEndMs = -1;
+  if (pushStats.lastClickToServerMs >= 0 && dispatched > 0)
+    endToEndMs = pushStats.lastClickToServerMs + static_cast<int32_t>((networkUs + pipelineStats.lastPushUs) / 1000);
+  Serial.printf("Push: live=%d connects=%u drops=%u failedConnects=%u applied=%u unchanged=%u bad=%u truncated=%u "
+                "version=%u "
+                "clickToServer=%dms net~%uus eventToRadio=%uus (mean %uus, max %uus) endToEnd~%dms\n",
+                pushChannel.live(), static_cast<unsigned>(pushChannel.connects()),
+                static_cast<unsigned>(pushChannel.drops()), static_cast<unsigned>(pushChannel.failedConnects()),
+                static_cast<unsigned>(pushStats.applied), static_cast<unsigned>(pushStats.unchanged),
+                static_cast<unsigned>(pushStats.badEvents),
+                static_cast<unsigned>(pushChannel.truncated()), static_cast<unsigned>(pushStats.lastVersion),
+                static_cast<int>(pushStats.lastClickToServerMs), static_cast<unsigned>(networkUs),
+                static_cast<unsigned>(pipelineStats.lastPushUs),
+                static_cast<unsigned>(dispatched ? pipelineStats.totalPushUs / dispatched : 0),
+                static_cast<unsigned>(pipelineStats.maxPushUs), static_cast<int>(endToEndMs));
+}
+
+// Where poll time goes: connect (new connections only), request to first
+// byte (server plus round trip, long-poll hold left out) and body transfer;
+// then what the polls delivered.
+void logStatusClientStats()
+{
+  const TankControl::HttpPhaseStats &connect = statusClient.connectStats();
+  const TankControl::HttpPhaseStats &firstByte = statusClient.firstByteStats();
+  const TankControl::HttpPhaseStats &body = statusClient.bodyStats();
+  const TankControl::HttpPhaseStats &total = statusClient.totalStats();
+  uint32_t responses = total.count ? total.count : 1;
+  Serial.printf("HTTP: polls=%u reused=%u connects=%u staleRetries=%u serverCloses=%u failed=%u "
+                "connect=%uus (mean %uus) firstByte=%uus (mean %uus, max %uus) body=%uus (mean %uus) "
+                "total=%uus (mean %uus, max %uus) rx=%uB/poll (last %uB) tx=%uB/poll\n",
+                static_cast<unsigned>(statusClient.requests()), static_cast<unsigned>(statusClient.reused()),
+                static_cast<unsigned>(statusClient.connects()), static_cast<unsigned>(statusClient.staleRetries()),
+                static_cast<unsigned>(statusClient.serverCloses()), static_cast<unsigned>(statusClient.failures()),
+                static_cast<unsigned>(connect.lastUs), static_cast<unsigned>(connect.meanUs()),
+                static_cast<unsigned>(firstByte.lastUs), static_cast<unsigned>(firstByte.meanUs()),
+                static_cast<unsigned>(firstByte.maxUs), static_cast<unsigned>(body.lastUs),
+                static_cast<unsigned>(body.meanUs()), static_cast<unsigned>(total.lastUs),
+                static_cast<unsigned>(total.meanUs()), static_cast<unsigned>(total.maxUs),
+                static_cast<unsigned>(statusClient.bytesReceived() / responses),
+                static_cast<unsigned>(statusClient.lastResponseBytes()),
+                static_cast<unsigned>(statusClient.bytesSent() / responses));
+  Serial.printf("Status: %s version=%u age=%ums changed=%u unchanged=%u notModified=%u resyncs=%u held=%ums "
+                "decode=%uus (mean %uus, max %uus) doc=%u/%uB\n",
+                statusBinary ? "bin" : "json", static_cast<unsigned>(appliedVersion),
+                static_cast<unsigned>(lastStatusAgeMs), static_cast<unsigned>(statusPollStats.changed),
+                static_cast<unsigned>(statusPollStats.unchanged), static_cast<unsigned>(statusPollStats.notModified),
+                static_cast<unsigned>(statusPollStats.resyncs), static_cast<unsigned>(statusClient.lastHeldMs()),
+                static_cast<unsigned>(statusDecodeStats.lastUs), static_cast<unsigned>(statusDecodeStats.meanUs()),
+                static_cast<unsigned>(statusDecodeStats.maxUs), static_cast<unsigned>(statusDoc.memoryUsage()),
+                static_cast<unsigned>(kStatusJsonSize));
+}
+
+// === NETWORK TASK ===
+void networkStep()
 {
   if (MODE == 1)
   {
@@ -500,6 +3058,8 @@ void loop()
       {
         Serial.println("WiFi LOST -> Sending STOP");
         sendStopCommand();
+        statusClient.stop();
+        pushChannel.stop();
       }
       else if (!wasConnected && currentlyConnected)
       {
@@ -516,10 +3076,17 @@ void loop()
 
     if (WiFi.status() == WL_CONNECTED)
     {
-      if (now - lastGetTime >= getInterval)
+      if (kPushEnabled)
+        servicePushChannel();
+      unsigned long pollInterval = kPushEnabled && pushChannel.live() ? kPushPollIntervalMs : getInterval;
+      if (statusClient.busy())
+      {
+        serviceStatusPoll();
+      }
+      else if (now - lastGetTime >= pollInterval)
       {
         lastGetTime = now;
-        performHttpGet();
+        startStatusPoll();
       }
     }
     else
@@ -532,4 +3099,237 @@ void loop()
       }
     }
   }
-}
\ No newline at end of file
+
+  static unsigned long lastTxStatsLog = 0;
+  if (millis() - lastTxStatsLog >= 30000)
+  {
+    lastTxStatsLog = millis();
+    Serial.printf("TX queue: depth=%u max=%u sent=%u failed=%u dropped=%u preempted=%u done=%uus (max %uus)\n",
+                  static_cast<unsigned>(txStats.depth), static_cast<unsigned>(txStats.maxDepth),
+                  static_cast<unsigned>(txStats.sent), static_cast<unsigned>(txStats.failed),
+                  static_cast<unsigned>(txStats.dropped), static_cast<unsigned>(txStats.preempted),
+                  static_cast<unsigned>(txStats.lastTxDoneUs), static_cast<unsigned>(txStats.maxTxDoneUs));
+    if (kLbtEnabled)
+    {
+      Serial.printf("LBT: checks=%u busy=%u forced=%u cadTimeouts=%u delay=%uus (mean %uus, max %uus)\n",
+                    static_cast<unsigned>(lbt.checks()), static_cast<unsigned>(lbt.busy()),
+                    static_cast<unsigned>(lbt.forced()), static_cast<unsigned>(lbtCadTimeouts),
+                    static_cast<unsigned>(lbt.lastDelayUs()), static_cast<unsigned>(lbt.meanDelayUs()),
+                    static_cast<unsigned>(lbt.maxDelayUs()));
+    }
+    uint32_t handled = pipelineStats.handled;
+    Serial.printf("Tasks: radio=%u%% net=%u%% ring=%u/%u queue=%uus (max %uus, avg %uus) ringFull=%u deadlineStops=%u\n",
+                  radioLoad.percent, networkLoad.percent,
+                  static_cast<unsigned>(radioRing.size()), static_cast<unsigned>(radioRing.capacity()),
+                  static_cast<unsigned>(pipelineStats.lastQueueUs), static_cast<unsigned>(pipelineStats.maxQueueUs),
+                  static_cast<unsigned>(handled ? pipelineStats.totalQueueUs / handled : 0),
+                  static_cast<unsigned>(pipelineStats.postFailed),
+                  static_cast<unsigned>(pipelineStats.deadlineStops));
+    Serial.printf("Airtime: %ums/s of %ums/s, coalesced=%u deferred=%u\n",
+                  static_cast<unsigned>(airtimeBudget.usedLastSecondUs() / 1000),
+                  static_cast<unsigned>(airtimeBudget.budgetUs() / 1000),
+                  static_cast<unsigned>(pipelineStats.coalesced),
+                  static_cast<unsigned>(pipelineStats.budgetDeferred));
+    const TankControl::LatencyHistogram &rtt = ackTracker.rtt();
+    Serial.printf("Link: sent=%u acked=%u lost=%u unmatched=%u bad=%u rtt p50=%uus p90=%uus p99=%uus max=%uus "
+                  "bursts=%u/%u/%u/%u/%u rx=%ddBm/%.1fdB tx=%ddBm/%.2fdB motors=%d/%d\n",
+                  static_cast<unsigned>(ackTracker.sent()), static_cast<unsigned>(ackTracker.delivered()),
+                  static_cast<unsigned>(ackTracker.lost()), static_cast<unsigned>(ackTracker.unmatched()),
+                  static_cast<unsigned>(linkTelemetry.badFrames),
+                  static_cast<unsigned>(rtt.percentileUs(50)), static_cast<unsigned>(rtt.percentileUs(90)),
+                  static_cast<unsigned>(rtt.percentileUs(99)), static_cast<unsigned>(rtt.maxUs()),
+                  static_cast<unsigned>(ackTracker.lossBursts(0)), static_cast<unsigned>(ackTracker.lossBursts(1)),
+                  static_cast<unsigned>(ackTracker.lossBursts(2)), static_cast<unsigned>(ackTracker.lossBursts(3)),
+                  static_cast<unsigned>(ackTracker.lossBursts(4)),
+                  linkTelemetry.localRssiDbm, linkTelemetry.localSnrDb,
+                  linkTelemetry.remoteRssiDbm, linkTelemetry.remoteSnrQuarterDb / 4.0f,
+                  linkTelemetry.leftMotor, linkTelemetry.rightMotor);
+    if (kHeartbeatMs > 0)
+    {
+      Serial.printf("Heartbeat: period=%ums sent=%u failed=%u deferred=%u\n", static_cast<unsigned>(kHeartbeatMs),
+                    static_cast<unsigned>(heartbeatStats.sent), static_cast<unsigned>(heartbeatStats.failed),
+                    static_cast<unsigned>(heartbeatStats.deferred));
+    }
+    if (MODE == 2)
+    {
+      logStatusClientStats();
+      if (kPushEnabled)
+        logPushStats();
+    }
+    if (kFleetSize > 1)
+    {
+      Serial.print("Fleet:");
+      for (uint8_t i = 0; i < kFleetSize; ++i)
+      {
+        Serial.printf(" v%u=%s served=%u wait=%uus (max %uus)", i + 1, vehicleStates[i].lastState.c_str(),
+                      static_cast<unsigned>(fleetStats.served[i]), static_cast<unsigned>(fleetStats.lastWaitUs[i]),
+                      static_cast<unsigned>(fleetStats.maxWaitUs[i]));
+      }
+      Serial.printf(" bound=%uus\n", static_cast<unsigned>(fleetLimits.worstLatencyUs));
+    }
+    if (CONFIG_ADR_ENABLE)
+    {
+      Serial.printf("ADR: SF%u/%ukHz margin=%.1fdB proposals=%u switches=%u rejected=%u reverts=%u fallbacks=%u\n",
+                    radioProfile.spreadingFactor, static_cast<unsigned>(radioProfile.bandwidthHz / 1000),
+                    adaptiveRate.lastMarginDb(), static_cast<unsigned>(adrStats.proposals),
+                    static_cast<unsigned>(adrStats.switches), static_cast<unsigned>(adrStats.rejected),
+                    static_cast<unsigned>(adrStats.reverts), static_cast<unsigned>(adrStats.fallbacks));
+    }
+  }
+}
+
+void networkTask(void *)
+{
+  for (;;)
+  {
+    uint32_t busyStartUs = micros();
+    networkStep();
+    networkLoad.add(micros() - busyStartUs);
+    vTaskDelay(pdMS_TO_TICKS(kNetworkTaskPeriodMs));
+  }
+}
+
+// === SETUP ===
+void setup()
+{
+  setupBoards(/*disable_u8g2=*/true);
+  delay(1500);
+  while (!Serial)
+  {
+    delay(10);
+  }
+
+  Serial.println("\nT-Beam TX | LoRa Tank Controller");
+
+  if (!cipher.begin())
+  {
+    Serial.println("AES key setup failed; reboot required.");
+    while (true)
+      delay(1000);
+  }
+  if (!beginSequence())
+  {
+    Serial.println("Sequence epoch unavailable (NVS error or all epochs used); replace the key and erase NVS.");
+    while (true)
+      delay(1000);
+  }
+  Serial.printf("TX epoch %u\n", static_cast<unsigned>(TankControl::sequenceEpoch(sequenceCounter)));
+#ifdef CONFIG_CIPHER_BENCH
+  runCipherBenchmark();
+#endif
+  buildStatusFilter();
+#ifdef CONFIG_STATUS_BENCH
+  runStatusBenchmark();
+#endif
+
+  bool radioReady = beginLoRa();
+  if (!radioReady)
+  {
+    Serial.println("LoRa setup failed; reboot after checking the radio module.");
+    while (true)
+      delay(1000);
+  }
+#ifdef CONFIG_RADIO_SPI_BENCH
+  runRadioSpiBenchmark();
+#endif
+
+  // The link bench drives the radio synchronously, without the TX pipeline.
+  if (MODE == 3 || MODE == 4)
+  {
+    Serial.printf("Starting link benchmark %s (MODE %u)\n", MODE == 3 ? "sender" : "receiver", MODE);
+    xTaskCreatePinnedToCore(linkBenchTask, "bench", kTaskStackSize, nullptr, 3, nullptr, 1);
+    return;
+  }
+  // Not LoRa.onTxDone()/onReceive(): see onRadioDio0().
+  pinMode(RADIO_DIO0_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(RADIO_DIO0_PIN), onRadioDio0, RISING);
+
+  configureFleet();
+  reportHeartbeat();
+  refreshStopCache();
+  sendStopCommand();
+
+  if (MODE == 1)
+  {
+    Serial.println("Starting in AP + Web UI mode (MODE 1)");
+    WiFi.mode(WIFI_AP);
+    if (WiFi.softAP("TankController", "tank12345"))
+    {
+      Serial.print("SoftAP ready. SSID: TankController, IP: ");
+      Serial.println(WiFi.softAPIP());
+    }
+    else
+    {
+      Serial.println("Failed to start SoftAP.");
+    }
+
+    server.on("/", HTTP_GET, handleWebRoot);
+    server.on("/cmd", HTTP_POST, handleWebCommand);
+    server.on("/drive", HTTP_POST, handleWebDrive);
+    server.on("/stop/stats", HTTP_GET, handleWebStopStats);
+    server.on("/tx/stats", HTTP_GET, handleWebTxStats);
+    server.on("/pipeline/stats", HTTP_GET, handleWebPipelineStats);
+    server.on("/link/stats", HTTP_GET, handleWebLinkStats);
+    server.on("/fleet/stats", HTTP_GET, handleWebFleetStats);
+    server.onNotFound([]()
+                      { server.send(404, "application/json", "{\"error\":\"not found\"}"); });
+    server.begin();
+    Serial.println("Web UI ready at http://" + WiFi.softAPIP().toString());
+  }
+  else if (MODE == 2)
+  {
+    Serial.println("Starting in WiFi Client + Server GET mode (MODE 2)");
+    const char *statusUrl = statusBinary ? kServerBinaryUrl : kServerUrl;
+    if (!statusClient.begin(statusUrl))
+    {
+      Serial.printf("Bad status URL %s, polls will fail\n", statusUrl);
+    }
+    if (kPushEnabled && !pushChannel.begin(kEventsUrl, kPushConnectTimeoutMs))
+    {
+      Serial.printf("Bad events URL %s, polling only\n", kEventsUrl);
+    }
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(kStaSsid, kStaPassword);
+
+    Serial.print("Connecting to ");
+    Serial.println(kStaSsid);
+
+    unsigned long startAttemptTime = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < 10000)
+    {
+      delay(500);
+      Serial.print(".");
+    }
+
+    if (WiFi.status() == WL_CONNECTED)
+    {
+      Serial.println("\nWiFi connected!");
+      Serial.print("IP: ");
+      Serial.println(WiFi.localIP());
+      wasConnected = true;
+    }
+    else
+    {
+      Serial.println("\nFailed to connect to WiFi. Will retry in loop.");
+      sendStopCommand();
+    }
+  }
+  else
+  {
+    Serial.println("Invalid MODE. Must be 1 to 4.");
+    while (true)
+      delay(1000);
+  }
+
+  // Radio on the app core, network next to the WiFi stack on the pro core.
+  networkOkMs.store(millis(), std::memory_order_release);
+  xTaskCreatePinnedToCore(radioTask, "radio", kTaskStackSize, nullptr, 3, &radioTaskHandle, 1);
+  xTaskCreatePinnedToCore(networkTask, "network", kTaskStackSize, nullptr, 1, nullptr, 0);
+}
+
+// === LOOP ===
+// All work runs in networkTask and radioTask; the Arduino loop task exits.
+void loop()
+{
+  vTaskDelete(nullptr);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Platform.h"
+
+// LoRa time-on-air model (SX127x datasheet, "Time on air") and a per-second
+// airtime budget for scheduling transmissions against channel capacity.
+
+namespace TankControl {
+
+// Modem settings that determine time on air. codingRate is the denominator
+// of 4/x (5..8), exactly as passed to LoRa.setCodingRate4().
+struct RadioProfile {
+  uint8_t spreadingFactor;
+  uint32_t bandwidthHz;
+  uint8_t codingRate;
+  uint16_t preambleSymbols;
+  bool crc;
+  bool implicitHeader;
+};
+
+constexpr RadioProfile kDefaultRadioProfile = {7, 125000, 5, 8, true, false};
+
+// Duration of one symbol, 2^SF / BW.
+inline uint32_t symbolTimeUs(const RadioProfile &profile) {
+  return static_cast<uint32_t>((static_cast<uint64_t>(1)
+                                << profile.spreadingFactor) *
+                               1000000ull / profile.bandwidthHz);
+}
+
+// The modem must use low data rate optimisation once a symbol exceeds 16 ms
+// (the LoRa library enables it under the same rule).
+inline bool lowDataRateOptimize(const RadioProfile &profile) {
+  return symbolTimeUs(profile) > 16000;
+}
+
+// Symbols after the preamble: 8 + ceil((8PL - 4SF + 28 + 16CRC - 20IH) /
+// 4(SF - 2DE)) * (CR + 4), never less than 8.
+inline uint32_t payloadSymbols(const RadioProfile &profile, size_t length) {
+  int32_t sf = profile.spreadingFactor;
+  int32_t numerator = 8 * static_cast<int32_t>(length) - 4 * sf + 28 +
+                      (profile.crc ? 16 : 0) -
+                      (profile.implicitHeader ? 20 : 0);
+  int32_t denominator = 4 * (sf - (lowDataRateOptimize(profile) ? 2 : 0));
+  int32_t blocks =
+      numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+  return 8 + static_cast<uint32_t>(blocks) * profile.codingRate;
+}
+
+// Total packet time: (preamble + 4.25 + payload symbols) symbol times.
+// Counted in quarter symbols so the 4.25 stays exact in integer math.
+inline uint32_t timeOnAirUs(const RadioProfile &profile, size_t length) {
+  uint64_t quarterSymbols =
+      4ull * (profile.preambleSymbols + payloadSymbols(profile, length)) + 17;
+  return static_cast<uint32_t>(quarterSymbols *
+                               (1ull << profile.spreadingFactor) * 1000000ull /
+                               (4ull * profile.bandwidthHz));
+}
+
+// Token bucket holding at most one second of airtime, refilled continuously
+// at budgetUsPerSecond. Safety traffic may charge() past zero; the debt is
+// paid back before anything else passes allows().
+class AirtimeBudget {
+ public:
+  explicit AirtimeBudget(uint32_t budgetUsPerSecond = 500000)
+      : budgetUs_(budgetUsPerSecond), tokensUs_(budgetUsPerSecond) {}
+
+  void setBudget(uint32_t budgetUsPerSecond) {
+    budgetUs_ = budgetUsPerSecond;
+    if (tokensUs_ > budgetUs_) {
+      tokensUs_ = budgetUs_;
+    }
+  }
+  uint32_t budgetUs() const { return budgetUs_; }
+
+  // True if a packet of airUs fits now. A packet longer than the whole
+  // budget is let through once the bucket is full.
+  bool allows(uint32_t airUs, uint32_t nowUs) {
+    refill(nowUs);
+    return tokensUs_ >= static_cast<int64_t>(airUs) ||
+           tokensUs_ >= static_cast<int64_t>(budgetUs_);
+  }
+
+  void charge(uint32_t airUs, uint32_t nowUs) {
+    refill(nowUs);
+    tokensUs_ -= airUs;
+    windowUsedUs_ += airUs;
+  }
+
+  // Airtime charged during the last complete one-second window.
+  uint32_t usedLastSecondUs() const { return lastWindowUsedUs_; }
+
+ private:
+  void refill(uint32_t nowUs) {
+    if (!started_) {
+      started_ = true;
+      lastRefillUs_ = nowUs;
+      windowStartUs_ = nowUs;
+    }
+    uint32_t elapsedUs = nowUs - lastRefillUs_;
+    lastRefillUs_ = nowUs;
+    tokensUs_ += static_cast<int64_t>(elapsedUs) * budgetUs_ / 1000000;
+    if (tokensUs_ > static_cast<int64_t>(budgetUs_)) {
+      tokensUs_ = budgetUs_;
+    }
+    if (nowUs - windowStartUs_ >= 1000000) {
+      lastWindowUsedUs_ = windowUsedUs_;
+      windowUsedUs_ = 0;
+      windowStartUs_ = nowUs;
+    }
+  }
+
+  uint32_t budgetUs_;
+  int64_t tokensUs_;
+  uint32_t lastRefillUs_ = 0;
+  uint32_t windowStartUs_ = 0;
+  uint32_t windowUsedUs_ = 0;
+  uint32_t lastWindowUsedUs_ = 0;
+  bool started_ = false;
+};
+
+}  // namespace TankControl
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <tuple>
+#include <type_traits>
+
+// Compile-time frame schemas. A frame is declared once as a list of fields;
+// FrameSchema derives every offset and the total size at compile time and
+// generates little-endian encode/decode for each field. FrameView and
+// FrameWriter are typed, zero-copy windows over a raw buffer, so a received
+// frame can be read field by field straight from the decrypted bytes.
+//
+//   using AckSchema = FrameSchema<Scalar<uint8_t>, Scalar<uint32_t>>;
+//   FrameView<AckSchema> ack(buffer, length);
+//   uint32_t sequence = ack.get<1>();
+
+namespace TankControl {
+
+// Unsigned or signed integer stored little-endian.
+template <typename T>
+struct Scalar {
+  static_assert(std::is_integral<T>::value, "Scalar fields must be integral");
+  using Value = T;
+  static constexpr size_t kSize = sizeof(T);
+
+  static T load(const uint8_t *data) {
+    using U = typename std::make_unsigned<T>::type;
+    U value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      value |= static_cast<U>(static_cast<U>(data[i]) << (8 * i));
+    }
+    return static_cast<T>(value);
+  }
+
+  static void store(uint8_t *data, T value) {
+    using U = typename std::make_unsigned<T>::type;
+    U raw = static_cast<U>(value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      data[i] = static_cast<uint8_t>(raw >> (8 * i));
+    }
+  }
+};
+
+// Opaque byte run (magic, tags, nested blocks). Reads return a pointer into
+// the underlying buffer rather than a copy.
+template <size_t N>
+struct Bytes {
+  using Value = const uint8_t *;
+  static constexpr size_t kSize = N;
+
+  static const uint8_t *load(const uint8_t *data) { return data; }
+
+  static void store(uint8_t *data, const uint8_t *value) {
+    memcpy(data, value, N);
+  }
+};
+
+namespace detail {
+
+template <typename... Fields>
+struct SizeOf;
+
+template <>
+struct SizeOf<> {
+  static constexpr size_t value = 0;
+};
+
+template <typename F, typename... Rest>
+struct SizeOf<F, Rest...> {
+  static constexpr size_t value = F::kSize + SizeOf<Rest...>::value;
+};
+
+template <size_t I, typename... Fields>
+struct OffsetOf;
+
+template <typename F, typename... Rest>
+struct OffsetOf<0, F, Rest...> {
+  static constexpr size_t value = 0;
+};
+
+template <size_t I, typename F, typename... Rest>
+struct OffsetOf<I, F, Rest...> {
+  static constexpr size_t value = F::kSize + OffsetOf<I - 1, Rest...>::value;
+};
+
+}  // namespace detail
+
+template <typename... Fields>
+struct FrameSchema {
+  static constexpr size_t kFieldCount = sizeof...(Fields);
+  static constexpr size_t kSize = detail::SizeOf<Fields...>::value;
+
+  template <size_t I>
+  using FieldAt = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+  template <size_t I>
+  static constexpr size_t offset() {
+    return detail::OffsetOf<I, Fields...>::value;
+  }
+
+  template <size_t I>
+  static typename FieldAt<I>::Value get(const uint8_t *data) {
+    return FieldAt<I>::load(data + offset<I>());
+  }
+
+  template <size_t I>
+  static void set(uint8_t *data, typename FieldAt<I>::Value value) {
+    FieldAt<I>::store(data + offset<I>(), value);
+  }
+};
+
+// Read-only typed view. Invalid (valid() == false) when the buffer is too
+// short for the schema; callers check once and then read fields freely.
+template <typename Schema>
+class FrameView {
+ public:
+  FrameView() = default;
+  FrameView(const uint8_t *data, size_t length)
+      : data_(data && length >= Schema::kSize ? data : nullptr) {}
+
+  bool valid() const { return data_ != nullptr; }
+  const uint8_t *data() const { return data_; }
+
+  template <size_t I>
+  typename Schema::template FieldAt<I>::Value get() const {
+    return Schema::template get<I>(data_);
+  }
+
+ private:
+  const uint8_t *data_ = nullptr;
+};
+
+template <typename Schema>
+class FrameWriter {
+ public:
+  FrameWriter(uint8_t *data, size_t length)
+      : data_(data && length >= Schema::kSize ? data : nullptr) {}
+
+  bool valid() const { return data_ != nullptr; }
+  uint8_t *data() const { return data_; }
+
+  template <size_t I>
+  void set(typename Schema::template FieldAt<I>::Value value) {
+    Schema::template set<I>(data_, value);
+  }
+
+  FrameView<Schema> view() const {
+    return FrameView<Schema>(data_, data_ ? Schema::kSize : 0);
+  }
+
+ private:
+  uint8_t *data_;
+};
+
+}  // namespace TankControl
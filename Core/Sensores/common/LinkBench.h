@@ -0,0 +1,244 @@
+#pragma once
+
+#include "ControlProtocol.h"
+
+// Over-the-air link benchmark. A sender steps through radio settings and,
+// for each step, announces it on the base profile, sends numbered probes on
+// the step's profile and collects the receiver's report back on the base
+// profile. Bench frames are plaintext: they carry no commands and the kind
+// byte keeps them apart from control frames.
+
+namespace TankControl {
+
+constexpr uint8_t kBenchAnnounceKind = 0xB0;
+constexpr uint8_t kBenchProbeKind = 0xB1;
+constexpr uint8_t kBenchReportKind = 0xB2;
+
+// Probes per step are capped so the receiver can keep every sample.
+constexpr uint16_t kBenchMaxProbes = 200;
+
+// One sweep step. bandwidthCode indexes bandwidthFromCode(); codingRate is
+// the denominator of 4/x.
+struct BenchStep {
+  uint16_t runId;
+  uint8_t index;
+  uint8_t spreadingFactor;
+  uint8_t bandwidthCode;
+  uint8_t codingRate;
+  int8_t txPowerDbm;
+  uint8_t payloadSize;
+  uint16_t probes;
+  uint32_t windowMs;
+};
+
+// kind, runId, index, SF, bandwidth code, CR, power, payload size, probes,
+// window (ms the receiver stays on the step profile after the announce).
+using BenchAnnounceSchema =
+    FrameSchema<Scalar<uint8_t>, Scalar<uint16_t>, Scalar<uint8_t>,
+                Scalar<uint8_t>, Scalar<uint8_t>, Scalar<uint8_t>,
+                Scalar<int8_t>, Scalar<uint8_t>, Scalar<uint16_t>,
+                Scalar<uint32_t>>;
+
+// kind, runId, step index, probe number. Padding up to payloadSize follows.
+using BenchProbeSchema = FrameSchema<Scalar<uint8_t>, Scalar<uint16_t>,
+                                     Scalar<uint8_t>, Scalar<uint16_t>>;
+
+// kind, runId, step index, received, duplicates, then RSSI (dBm) and SNR
+// (0.25 dB) as min, p10, p50, p90, max.
+using BenchReportSchema =
+    FrameSchema<Scalar<uint8_t>, Scalar<uint16_t>, Scalar<uint8_t>,
+                Scalar<uint16_t>, Scalar<uint16_t>, Bytes<10>, Bytes<5>>;
+
+constexpr size_t kBenchAnnounceSize = BenchAnnounceSchema::kSize;
+constexpr size_t kBenchProbeHeaderSize = BenchProbeSchema::kSize;
+constexpr size_t kBenchReportSize = BenchReportSchema::kSize;
+
+inline size_t encodeBenchAnnounce(const BenchStep &step, uint8_t *out,
+                                  size_t outLength) {
+  FrameWriter<BenchAnnounceSchema> w(out, outLength);
+  if (!w.valid()) {
+    return 0;
+  }
+  w.set<0>(kBenchAnnounceKind);
+  w.set<1>(step.runId);
+  w.set<2>(step.index);
+  w.set<3>(step.spreadingFactor);
+  w.set<4>(step.bandwidthCode);
+  w.set<5>(step.codingRate);
+  w.set<6>(step.txPowerDbm);
+  w.set<7>(step.payloadSize);
+  w.set<8>(step.probes);
+  w.set<9>(step.windowMs);
+  return kBenchAnnounceSize;
+}
+
+inline bool decodeBenchAnnounce(const uint8_t *in, size_t length,
+                                BenchStep &step) {
+  FrameView<BenchAnnounceSchema> v(in, length);
+  if (!v.valid() || length != kBenchAnnounceSize ||
+      v.get<0>() != kBenchAnnounceKind) {
+    return false;
+  }
+  step.runId = v.get<1>();
+  step.index = v.get<2>();
+  step.spreadingFactor = v.get<3>();
+  step.bandwidthCode = v.get<4>();
+  step.codingRate = v.get<5>();
+  step.txPowerDbm = v.get<6>();
+  step.payloadSize = v.get<7>();
+  step.probes = v.get<8>();
+  step.windowMs = v.get<9>();
+  return step.spreadingFactor >= 6 && step.spreadingFactor <= 12 &&
+         step.bandwidthCode < kBandwidthCodeCount && step.codingRate >= 5 &&
+         step.codingRate <= 8 && step.payloadSize >= kBenchProbeHeaderSize &&
+         step.probes <= kBenchMaxProbes;
+}
+
+// Fills a probe of step.payloadSize bytes. The padding is a function of the
+// probe number so every probe differs, as real traffic would.
+inline size_t encodeBenchProbe(const BenchStep &step, uint16_t probe,
+                               uint8_t *out, size_t outLength) {
+  if (outLength < step.payloadSize ||
+      step.payloadSize < kBenchProbeHeaderSize) {
+    return 0;
+  }
+  FrameWriter<BenchProbeSchema> w(out, outLength);
+  w.set<0>(kBenchProbeKind);
+  w.set<1>(step.runId);
+  w.set<2>(step.index);
+  w.set<3>(probe);
+  uint32_t x = 0x9E3779B9u ^ (static_cast<uint32_t>(step.index) << 16);
+  x ^= probe;
+  for (size_t i = kBenchProbeHeaderSize; i < step.payloadSize; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    out[i] = static_cast<uint8_t>(x);
+  }
+  return step.payloadSize;
+}
+
+// Receiver side of one step: counts distinct probes and keeps RSSI/SNR of
+// each so the report can carry percentiles.
+class BenchCollector {
+ public:
+  void reset(const BenchStep &step) {
+    step_ = step;
+    received_ = 0;
+    duplicates_ = 0;
+    memset(seen_, 0, sizeof(seen_));
+  }
+
+  const BenchStep &step() const { return step_; }
+  uint16_t received() const { return received_; }
+  uint16_t duplicates() const { return duplicates_; }
+
+  // True if the packet is a probe of the current step.
+  bool addProbe(const uint8_t *in, size_t length, int16_t rssiDbm,
+                float snrDb) {
+    FrameView<BenchProbeSchema> v(in, length);
+    if (!v.valid() || v.get<0>() != kBenchProbeKind ||
+        v.get<1>() != step_.runId || v.get<2>() != step_.index) {
+      return false;
+    }
+    uint16_t probe = v.get<3>();
+    if (probe >= kBenchMaxProbes) {
+      return false;
+    }
+    if (seen_[probe / 8] & (1u << (probe % 8))) {
+      ++duplicates_;
+      return true;
+    }
+    seen_[probe / 8] |= static_cast<uint8_t>(1u << (probe % 8));
+    rssi_[received_] = rssiDbm;
+    snrQuarterDb_[received_] = static_cast<int8_t>(
+        snrDb * 4 < -128 ? -128 : (snrDb * 4 > 127 ? 127 : snrDb * 4));
+    ++received_;
+    return true;
+  }
+
+  size_t encodeReport(uint8_t *out, size_t outLength) {
+    FrameWriter<BenchReportSchema> w(out, outLength);
+    if (!w.valid()) {
+      return 0;
+    }
+    w.set<0>(kBenchReportKind);
+    w.set<1>(step_.runId);
+    w.set<2>(step_.index);
+    w.set<3>(received_);
+    w.set<4>(duplicates_);
+    int16_t rssi[5];
+    int8_t snr[5];
+    summarize(rssi_, rssi);
+    summarize(snrQuarterDb_, snr);
+    uint8_t *rssiOut = out + BenchReportSchema::offset<5>();
+    uint8_t *snrOut = out + BenchReportSchema::offset<6>();
+    for (size_t i = 0; i < 5; ++i) {
+      Scalar<int16_t>::store(rssiOut + 2 * i, rssi[i]);
+      Scalar<int8_t>::store(snrOut + i, snr[i]);
+    }
+    return kBenchReportSize;
+  }
+
+ private:
+  // min, p10, p50, p90, max by nearest rank; zeros when nothing arrived.
+  // Sorts samples in place (insertion sort, at most kBenchMaxProbes).
+  template <typename T>
+  void summarize(T *samples, T (&out)[5]) const {
+    for (size_t i = 1; i < received_; ++i) {
+      T value = samples[i];
+      size_t j = i;
+      for (; j > 0 && samples[j - 1] > value; --j) {
+        samples[j] = samples[j - 1];
+      }
+      samples[j] = value;
+    }
+    static const uint8_t kPercentiles[5] = {0, 10, 50, 90, 100};
+    for (size_t i = 0; i < 5; ++i) {
+      if (received_ == 0) {
+        out[i] = 0;
+        continue;
+      }
+      size_t rank =
+          (static_cast<size_t>(received_) * kPercentiles[i] + 99) / 100;
+      out[i] = samples[rank == 0 ? 0 : rank - 1];
+    }
+  }
+
+  BenchStep step_ = {};
+  uint16_t received_ = 0;
+  uint16_t duplicates_ = 0;
+  uint8_t seen_[(kBenchMaxProbes + 7) / 8] = {};
+  int16_t rssi_[kBenchMaxProbes];
+  int8_t snrQuarterDb_[kBenchMaxProbes];
+};
+
+// Sender side view of a report.
+struct BenchReport {
+  uint16_t runId;
+  uint8_t index;
+  uint16_t received;
+  uint16_t duplicates;
+  int16_t rssiDbm[5];
+  int8_t snrQuarterDb[5];
+};
+
+inline bool decodeBenchReport(const uint8_t *in, size_t length,
+                              BenchReport &report) {
+  FrameView<BenchReportSchema> v(in, length);
+  if (!v.valid() || length != kBenchReportSize ||
+      v.get<0>() != kBenchReportKind) {
+    return false;
+  }
+  report.runId = v.get<1>();
+  report.index = v.get<2>();
+  report.received = v.get<3>();
+  report.duplicates = v.get<4>();
+  for (size_t i = 0; i < 5; ++i) {
+    report.rssiDbm[i] = Scalar<int16_t>::load(v.get<5>() + 2 * i);
+    report.snrQuarterDb[i] = Scalar<int8_t>::load(v.get<6>() + i);
+  }
+  return true;
+}
+
+}  // namespace TankControl
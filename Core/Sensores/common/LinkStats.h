@@ -0,0 +1,179 @@
+#pragma once
+
+#include "Platform.h"
+
+// Delivery bookkeeping for acknowledged frames: an RTT histogram with
+// percentile estimates and a tracker that matches ACKs to sent sequences
+// and records loss bursts.
+
+namespace TankControl {
+
+// Fixed-bucket latency histogram. Percentiles are reported as the upper
+// bound of the bucket they fall in (clamped to the largest sample), which
+// is exact enough for latency SLOs and needs no sample storage.
+class LatencyHistogram {
+ public:
+  static constexpr size_t kBuckets = 12;
+
+  // Upper bound of bucket i in ms; the last bucket is open-ended.
+  static uint32_t boundMs(size_t i) {
+    static const uint16_t kBoundsMs[kBuckets - 1] = {
+        25, 50, 75, 100, 150, 200, 300, 500, 750, 1000, 2000};
+    return i < kBuckets - 1 ? kBoundsMs[i] : 0xFFFFFFFFu;
+  }
+
+  void record(uint32_t us) {
+    size_t i = 0;
+    while (i < kBuckets - 1 && us > boundMs(i) * 1000) {
+      ++i;
+    }
+    ++buckets_[i];
+    ++count_;
+    totalUs_ += us;
+    if (count_ == 1 || us < minUs_) {
+      minUs_ = us;
+    }
+    if (us > maxUs_) {
+      maxUs_ = us;
+    }
+  }
+
+  // pct in 1..100. Returns 0 while empty.
+  uint32_t percentileUs(uint8_t pct) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint32_t rank = (static_cast<uint64_t>(count_) * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        uint64_t boundUs = static_cast<uint64_t>(boundMs(i)) * 1000;
+        return boundUs < maxUs_ ? static_cast<uint32_t>(boundUs) : maxUs_;
+      }
+    }
+    return maxUs_;
+  }
+
+  uint32_t bucket(size_t i) const { return i < kBuckets ? buckets_[i] : 0; }
+  uint32_t count() const { return count_; }
+  uint32_t minUs() const { return minUs_; }
+  uint32_t maxUs() const { return maxUs_; }
+  uint32_t meanUs() const {
+    return count_ ? static_cast<uint32_t>(totalUs_ / count_) : 0;
+  }
+
+ private:
+  uint32_t buckets_[kBuckets] = {};
+  uint32_t count_ = 0;
+  uint64_t totalUs_ = 0;
+  uint32_t minUs_ = 0;
+  uint32_t maxUs_ = 0;
+};
+
+// Matches ACKs to sent frames. Frames are finalised strictly in send order,
+// as delivered once acked or as lost once unacked for timeoutUs (or when
+// the in-flight window overflows). That keeps loss-burst lengths exact even
+// when later ACKs arrive before an earlier frame times out.
+class AckTracker {
+ public:
+  static constexpr size_t kCapacity = 32;
+  // Loss bursts of 1, 2, 3, 4-7 and 8+ consecutive frames.
+  static constexpr size_t kBurstBuckets = 5;
+
+  explicit AckTracker(uint32_t timeoutUs = 1500000) : timeoutUs_(timeoutUs) {}
+
+  void setTimeoutUs(uint32_t timeoutUs) { timeoutUs_ = timeoutUs; }
+
+  void onSent(uint32_t sequence, uint32_t sentUs) {
+    if (count_ == kCapacity) {
+      finalizeOldest();
+    }
+    Entry &entry = entries_[(head_ + count_) % kCapacity];
+    entry.sequence = sequence;
+    entry.sentUs = sentUs;
+    entry.acked = false;
+    ++count_;
+    ++sent_;
+  }
+
+  // True (with the round trip in rttUs) for the first ACK of an in-flight
+  // sequence; duplicates and unknown sequences are only counted.
+  bool onAck(uint32_t sequence, uint32_t nowUs, uint32_t &rttUs) {
+    for (size_t i = 0; i < count_; ++i) {
+      Entry &entry = entries_[(head_ + i) % kCapacity];
+      if (entry.sequence == sequence && !entry.acked) {
+        entry.acked = true;
+        rttUs = nowUs - entry.sentUs;
+        rtt_.record(rttUs);
+        return true;
+      }
+    }
+    ++unmatched_;
+    return false;
+  }
+
+  // Finalises frames at the head of the window that are acked or timed out.
+  void expire(uint32_t nowUs) {
+    while (count_ > 0) {
+      const Entry &oldest = entries_[head_];
+      if (!oldest.acked && nowUs - oldest.sentUs < timeoutUs_) {
+        break;
+      }
+      finalizeOldest();
+    }
+  }
+
+  const LatencyHistogram &rtt() const { return rtt_; }
+  uint32_t sent() const { return sent_; }
+  uint32_t delivered() const { return delivered_; }
+  uint32_t lost() const { return lost_; }
+  uint32_t unmatched() const { return unmatched_; }
+  size_t inFlight() const { return count_; }
+  uint32_t lossBursts(size_t i) const {
+    return i < kBurstBuckets ? bursts_[i] : 0;
+  }
+
+ private:
+  struct Entry {
+    uint32_t sequence;
+    uint32_t sentUs;
+    bool acked;
+  };
+
+  void finalizeOldest() {
+    const Entry &oldest = entries_[head_];
+    if (oldest.acked) {
+      ++delivered_;
+      closeBurst();
+    } else {
+      ++lost_;
+      ++burst_;
+    }
+    head_ = (head_ + 1) % kCapacity;
+    --count_;
+  }
+
+  void closeBurst() {
+    if (burst_ == 0) {
+      return;
+    }
+    size_t i = burst_ <= 3 ? burst_ - 1 : (burst_ <= 7 ? 3 : 4);
+    ++bursts_[i];
+    burst_ = 0;
+  }
+
+  uint32_t timeoutUs_;
+  Entry entries_[kCapacity];
+  size_t head_ = 0;
+  size_t count_ = 0;
+  uint32_t burst_ = 0;
+  uint32_t sent_ = 0;
+  uint32_t delivered_ = 0;
+  uint32_t lost_ = 0;
+  uint32_t unmatched_ = 0;
+  uint32_t bursts_[kBurstBuckets] = {};
+  LatencyHistogram rtt_;
+};
+
+}  // namespace TankControl
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Airtime.h"
+
+// Listen-before-talk on top of SX127x channel activity detection (CAD).
+// Before a frame goes out the radio runs one CAD; if it hears LoRa chirps
+// the frame backs off for a random time and checks again. After
+// kMaxAttempts busy checks it is sent anyway, so the added latency has a
+// hard bound. CAD only detects the same spreading factor and bandwidth;
+// other SFs are left to LoRa's quasi-orthogonality.
+
+namespace TankControl {
+
+// One CAD takes about two symbols: one listening, then the correlation.
+inline uint32_t cadTimeUs(const RadioProfile &profile) {
+  return 2 * symbolTimeUs(profile);
+}
+
+class ListenBeforeTalk {
+ public:
+  static constexpr uint8_t kMaxAttempts = 4;
+
+  // Upper bound on the delay LBT adds to one frame: every CAD plus the
+  // largest backoff of each retry.
+  static uint32_t worstDelayUs(uint32_t cadUs, uint32_t frameAirUs) {
+    uint32_t delayUs = kMaxAttempts * cadUs;
+    for (uint8_t attempt = 1; attempt < kMaxAttempts; ++attempt) {
+      delayUs += cadUs + (frameAirUs << (attempt - 1));
+    }
+    return delayUs;
+  }
+
+  // A new frame is waiting for the channel.
+  void start(uint32_t nowUs) {
+    attempts_ = 0;
+    startUs_ = nowUs;
+  }
+
+  // Feeds one CAD result. Returns 0 to transmit now, otherwise the backoff
+  // in microseconds before the next CAD. The backoff is one CAD time plus a
+  // random share of frameAirUs * 2^(busy checks so far - 1), so contenders
+  // spread out within about one frame.
+  uint32_t next(bool busy, uint32_t cadUs, uint32_t frameAirUs,
+                uint32_t random32) {
+    ++checks_;
+    ++attempts_;
+    if (!busy) {
+      return 0;
+    }
+    ++busy_;
+    if (attempts_ >= kMaxAttempts) {
+      ++forced_;
+      return 0;
+    }
+    uint32_t windowUs = frameAirUs << (attempts_ - 1);
+    return cadUs + (windowUs ? random32 % windowUs : 0);
+  }
+
+  // The frame started at nowUs; records how long LBT held it.
+  void transmitted(uint32_t nowUs) {
+    lastDelayUs_ = nowUs - startUs_;
+    if (lastDelayUs_ > maxDelayUs_) {
+      maxDelayUs_ = lastDelayUs_;
+    }
+    totalDelayUs_ += lastDelayUs_;
+    ++frames_;
+  }
+
+  uint32_t checks() const { return checks_; }
+  uint32_t busy() const { return busy_; }
+  uint32_t forced() const { return forced_; }
+  uint32_t frames() const { return frames_; }
+  uint32_t lastDelayUs() const { return lastDelayUs_; }
+  uint32_t maxDelayUs() const { return maxDelayUs_; }
+  uint32_t meanDelayUs() const {
+    return frames_ ? static_cast<uint32_t>(totalDelayUs_ / frames_) : 0;
+  }
+
+ private:
+  uint8_t attempts_ = 0;
+  uint32_t startUs_ = 0;
+  uint32_t checks_ = 0;
+  uint32_t busy_ = 0;
+  uint32_t forced_ = 0;
+  uint32_t frames_ = 0;
+  uint32_t lastDelayUs_ = 0;
+  uint32_t maxDelayUs_ = 0;
+  uint64_t totalDelayUs_ = 0;
+};
+
+}  // namespace TankControl
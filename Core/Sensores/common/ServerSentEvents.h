@@ -0,0 +1,226 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Incremental text/event-stream (Server-Sent Events) parser. It is fed the
+// de-chunked response body one byte at a time and reports each complete
+// event. Only the fields the controller uses are kept: event, data (lines
+// joined with '\n') and a numeric id. Comment lines (": ping") count as
+// activity. An event whose data does not fit DataCapacity is flagged
+// truncated rather than silently cut, so the caller can drop it.
+
+namespace TankControl {
+
+template <size_t DataCapacity>
+class SseParser {
+ public:
+  static constexpr size_t kMaxNameLength = 15;
+
+  void reset() {
+    lineState_ = LineState::Start;
+    field_ = Field::None;
+    fieldLength_ = 0;
+    clearEvent();
+    ready_ = false;
+  }
+
+  // Feeds one body byte. Returns true when it completed an event; read it
+  // before feeding the next byte.
+  bool feed(uint8_t byte) {
+    if (ready_) {
+      clearEvent();
+      ready_ = false;
+    }
+    if (byte == '\r') {
+      return false;
+    }
+    if (byte == '\n') {
+      return endLine();
+    }
+    switch (lineState_) {
+      case LineState::Start:
+        if (byte == ':') {
+          lineState_ = LineState::Comment;
+          return false;
+        }
+        lineState_ = LineState::Name;
+        fieldLength_ = 0;
+        // fall through
+      case LineState::Name:
+        if (byte == ':') {
+          field_ = fieldFromName();
+          lineState_ = LineState::ValueStart;
+          beginValue();
+        } else if (fieldLength_ < kMaxNameLength) {
+          name_[fieldLength_++] = static_cast<char>(byte);
+        } else {
+          fieldLength_ = kMaxNameLength + 1;
+        }
+        return false;
+      case LineState::ValueStart:
+        lineState_ = LineState::Value;
+        if (byte == ' ') {
+          return false;
+        }
+        // fall through
+      case LineState::Value:
+        appendValue(static_cast<char>(byte));
+        return false;
+      case LineState::Comment:
+        return false;
+    }
+    return false;
+  }
+
+  const char *event() const { return event_; }
+  bool isEvent(const char *name) const { return strcmp(event_, name) == 0; }
+  const char *data() const { return data_; }
+  // Writable view of the event data, for parsers that work in place (e.g.
+  // ArduinoJson with a char *). Valid until the next feed().
+  char *data() { return data_; }
+  size_t dataLength() const { return dataLength_; }
+  bool hasId() const { return hasId_; }
+  uint32_t id() const { return id_; }
+  bool truncated() const { return truncated_; }
+
+  uint32_t events() const { return events_; }
+  uint32_t comments() const { return comments_; }
+
+ private:
+  enum class LineState : uint8_t { Start, Name, ValueStart, Value, Comment };
+  enum class Field : uint8_t { None, Event, Data, Id };
+
+  Field fieldFromName() const {
+    if (fieldLength_ > kMaxNameLength) {
+      return Field::None;
+    }
+    if (matches("event")) {
+      return Field::Event;
+    }
+    if (matches("data")) {
+      return Field::Data;
+    }
+    if (matches("id")) {
+      return Field::Id;
+    }
+    return Field::None;
+  }
+
+  bool matches(const char *name) const {
+    size_t length = strlen(name);
+    return length == fieldLength_ && memcmp(name_, name, length) == 0;
+  }
+
+  void beginValue() {
+    switch (field_) {
+      case Field::Event:
+        eventLength_ = 0;
+        event_[0] = '\0';
+        break;
+      case Field::Data:
+        if (dataLines_++ > 0) {
+          appendData('\n');
+        }
+        break;
+      case Field::Id:
+        id_ = 0;
+        hasId_ = true;
+        break;
+      case Field::None:
+        break;
+    }
+  }
+
+  void appendValue(char c) {
+    switch (field_) {
+      case Field::Event:
+        if (eventLength_ < kMaxNameLength) {
+          event_[eventLength_++] = c;
+          event_[eventLength_] = '\0';
+        }
+        break;
+      case Field::Data:
+        appendData(c);
+        break;
+      case Field::Id:
+        if (c >= '0' && c <= '9') {
+          id_ = id_ * 10 + static_cast<uint32_t>(c - '0');
+        } else {
+          hasId_ = false;
+        }
+        break;
+      case Field::None:
+        break;
+    }
+  }
+
+  void appendData(char c) {
+    if (dataLength_ < DataCapacity) {
+      data_[dataLength_++] = c;
+      data_[dataLength_] = '\0';
+    } else {
+      truncated_ = true;
+    }
+  }
+
+  // A line with no colon is a field with an empty value.
+  bool endLine() {
+    LineState state = lineState_;
+    lineState_ = LineState::Start;
+    if (state == LineState::Comment) {
+      ++comments_;
+      return false;
+    }
+    if (state == LineState::Name) {
+      field_ = fieldFromName();
+      beginValue();
+      return false;
+    }
+    if (state != LineState::Start) {
+      return false;
+    }
+    // Blank line: dispatch. Events without data are dropped, as in
+    // browsers.
+    if (dataLines_ == 0) {
+      clearEvent();
+      return false;
+    }
+    if (event_[0] == '\0') {
+      memcpy(event_, "message", sizeof("message"));
+    }
+    ++events_;
+    ready_ = true;
+    return true;
+  }
+
+  void clearEvent() {
+    event_[0] = '\0';
+    eventLength_ = 0;
+    data_[0] = '\0';
+    dataLength_ = 0;
+    dataLines_ = 0;
+    id_ = 0;
+    hasId_ = false;
+    truncated_ = false;
+  }
+
+  LineState lineState_ = LineState::Start;
+  Field field_ = Field::None;
+  char name_[kMaxNameLength] = {};
+  size_t fieldLength_ = 0;
+  char event_[kMaxNameLength + 1] = {};
+  size_t eventLength_ = 0;
+  char data_[DataCapacity + 1] = {};
+  size_t dataLength_ = 0;
+  uint32_t dataLines_ = 0;
+  uint32_t id_ = 0;
+  bool hasId_ = false;
+  bool truncated_ = false;
+  bool ready_ = false;
+  uint32_t events_ = 0;
+  uint32_t comments_ = 0;
+};
+
+}  // namespace TankControl
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "ControlProtocol.h"
+#include "FrameSchema.h"
+
+// GET /status.bin: the status document as fixed little-endian records, for
+// clients that should not run a JSON parser on every poll. The Orion API
+// builds it from the same state as GET /status; long poll (?since=&wait=)
+// and 304 work the same way.
+//
+//   header   format, vehicle count, version, age ms
+//   vehicle  id, command, speedness, left, right, segment count,
+//            trajectory id, then its segments
+//   segment  command, speedness, duration ms
+//
+// Vehicles come in id order. Commands are TankControl::Command values; the
+// API sends Stop for a name it does not know. left/right are only set for
+// Drive, segments and trajectory id only for Trajectory. age ms is how long
+// before the response the version last changed.
+
+namespace TankControl {
+
+constexpr uint8_t kStatusBinaryFormat = 1;
+
+using StatusBinaryHeaderSchema =
+    FrameSchema<Scalar<uint8_t>, Scalar<uint8_t>, Scalar<uint32_t>,
+                Scalar<uint32_t>>;
+enum StatusBinaryHeaderField : size_t {
+  kStatusFormatField,
+  kStatusVehicleCountField,
+  kStatusVersionField,
+  kStatusAgeField
+};
+
+using StatusBinaryVehicleSchema =
+    FrameSchema<Scalar<uint8_t>, Scalar<uint8_t>, Scalar<uint8_t>,
+                Scalar<int8_t>, Scalar<int8_t>, Scalar<uint8_t>,
+                Scalar<uint32_t>>;
+enum StatusBinaryVehicleField : size_t {
+  kStatusVehicleIdField,
+  kStatusCommandField,
+  kStatusSpeednessField,
+  kStatusLeftField,
+  kStatusRightField,
+  kStatusSegmentCountField,
+  kStatusTrajectoryIdField
+};
+
+using StatusBinarySegmentSchema =
+    FrameSchema<Scalar<uint8_t>, Scalar<uint8_t>, Scalar<uint16_t>>;
+enum StatusBinarySegmentField : size_t {
+  kStatusSegmentCommandField,
+  kStatusSegmentSpeednessField,
+  kStatusSegmentDurationField
+};
+
+using StatusBinaryHeader = FrameView<StatusBinaryHeaderSchema>;
+using StatusBinaryVehicle = FrameView<StatusBinaryVehicleSchema>;
+using StatusBinarySegment = FrameView<StatusBinarySegmentSchema>;
+
+// Largest document for a fleet of n vehicles on full trajectories.
+constexpr size_t statusBinaryCapacity(size_t vehicles) {
+  return StatusBinaryHeaderSchema::kSize +
+         vehicles * (StatusBinaryVehicleSchema::kSize +
+                     kMaxTrajectorySegments * StatusBinarySegmentSchema::kSize);
+}
+
+// Zero-copy reader: begin() checks the whole layout once, then next()
+// steps through the vehicle records, which are views into the buffer.
+class StatusBinaryReader {
+ public:
+  // True if data holds a format 1 document whose vehicle records, with
+  // their segments, fill exactly length bytes.
+  bool begin(const uint8_t *data, size_t length) {
+    data_ = nullptr;
+    header_ = StatusBinaryHeader(data, length);
+    if (!header_.valid() ||
+        header_.get<kStatusFormatField>() != kStatusBinaryFormat) {
+      return false;
+    }
+    size_t at = StatusBinaryHeaderSchema::kSize;
+    for (uint8_t i = 0; i < header_.get<kStatusVehicleCountField>(); ++i) {
+      StatusBinaryVehicle vehicle(data + at, length - at);
+      if (!vehicle.valid()) {
+        return false;
+      }
+      uint8_t segments = vehicle.get<kStatusSegmentCountField>();
+      if (segments > kMaxTrajectorySegments) {
+        return false;
+      }
+      at += recordSize(segments);
+      if (at > length) {
+        return false;
+      }
+    }
+    if (at != length) {
+      return false;
+    }
+    data_ = data;
+    next_ = StatusBinaryHeaderSchema::kSize;
+    remaining_ = header_.get<kStatusVehicleCountField>();
+    return true;
+  }
+
+  // Valid once begin() has returned true.
+  uint8_t vehicleCount() const {
+    return header_.get<kStatusVehicleCountField>();
+  }
+  uint32_t version() const { return header_.get<kStatusVersionField>(); }
+  uint32_t ageMs() const { return header_.get<kStatusAgeField>(); }
+
+  // Moves to the next vehicle record; false after the last one.
+  bool next() {
+    if (data_ == nullptr || remaining_ == 0) {
+      return false;
+    }
+    vehicle_ = StatusBinaryVehicle(data_ + next_,
+                                   StatusBinaryVehicleSchema::kSize);
+    next_ += recordSize(vehicle_.get<kStatusSegmentCountField>());
+    --remaining_;
+    return true;
+  }
+
+  const StatusBinaryVehicle &vehicle() const { return vehicle_; }
+
+  // index < the current vehicle's segment count.
+  StatusBinarySegment segment(size_t index) const {
+    return StatusBinarySegment(vehicle_.data() +
+                                   StatusBinaryVehicleSchema::kSize +
+                                   index * StatusBinarySegmentSchema::kSize,
+                               StatusBinarySegmentSchema::kSize);
+  }
+
+ private:
+  static size_t recordSize(uint8_t segments) {
+    return StatusBinaryVehicleSchema::kSize +
+           segments * StatusBinarySegmentSchema::kSize;
+  }
+
+  const uint8_t *data_ = nullptr;
+  StatusBinaryHeader header_;
+  StatusBinaryVehicle vehicle_;
+  size_t next_ = 0;
+  uint8_t remaining_ = 0;
+};
+
+// Builds a document the way the API does; for benchmarks and checks.
+// Every add returns false, and leaves the buffer unchanged, if it would
+// not fit.
+class StatusBinaryWriter {
+ public:
+  StatusBinaryWriter(uint8_t *data, size_t capacity)
+      : data_(data), capacity_(capacity) {}
+
+  bool begin(uint32_t version, uint32_t ageMs) {
+    FrameWriter<StatusBinaryHeaderSchema> header(data_, capacity_);
+    if (!header.valid()) {
+      return false;
+    }
+    header.set<kStatusFormatField>(kStatusBinaryFormat);
+    header.set<kStatusVehicleCountField>(0);
+    header.set<kStatusVersionField>(version);
+    header.set<kStatusAgeField>(ageMs);
+    length_ = StatusBinaryHeaderSchema::kSize;
+    vehicle_ = 0;
+    return true;
+  }
+
+  bool addVehicle(uint8_t id, Command command, uint8_t speedness,
+                  int8_t left, int8_t right, uint32_t trajectoryId) {
+    if (length_ == 0) {
+      return false;
+    }
+    FrameWriter<StatusBinaryVehicleSchema> vehicle(data_ + length_,
+                                                   capacity_ - length_);
+    uint8_t count = StatusBinaryHeaderSchema::get<kStatusVehicleCountField>(
+        data_);
+    if (!vehicle.valid() || count == UINT8_MAX) {
+      return false;
+    }
+    vehicle.set<kStatusVehicleIdField>(id);
+    vehicle.set<kStatusCommandField>(static_cast<uint8_t>(command));
+    vehicle.set<kStatusSpeednessField>(speedness);
+    vehicle.set<kStatusLeftField>(left);
+    vehicle.set<kStatusRightField>(right);
+    vehicle.set<kStatusSegmentCountField>(0);
+    vehicle.set<kStatusTrajectoryIdField>(trajectoryId);
+    StatusBinaryHeaderSchema::set<kStatusVehicleCountField>(data_, count + 1);
+    vehicle_ = length_;
+    length_ += StatusBinaryVehicleSchema::kSize;
+    return true;
+  }
+
+  // Appends a segment to the last vehicle added.
+  bool addSegment(Command command, uint8_t speedness, uint16_t durationMs) {
+    if (vehicle_ == 0) {
+      return false;
+    }
+    uint8_t *vehicle = data_ + vehicle_;
+    uint8_t count =
+        StatusBinaryVehicleSchema::get<kStatusSegmentCountField>(vehicle);
+    FrameWriter<StatusBinarySegmentSchema> segment(data_ + length_,
+                                                   capacity_ - length_);
+    if (!segment.valid() || count == kMaxTrajectorySegments) {
+      return false;
+    }
+    segment.set<kStatusSegmentCommandField>(static_cast<uint8_t>(command));
+    segment.set<kStatusSegmentSpeednessField>(speedness);
+    segment.set<kStatusSegmentDurationField>(durationMs);
+    StatusBinaryVehicleSchema::set<kStatusSegmentCountField>(vehicle,
+                                                             count + 1);
+    length_ += StatusBinarySegmentSchema::kSize;
+    return true;
+  }
+
+  size_t length() const { return length_; }
+
+ private:
+  uint8_t *data_;
+  size_t capacity_;
+  size_t length_ = 0;
+  size_t vehicle_ = 0;
+};
+
+}  // namespace TankControl
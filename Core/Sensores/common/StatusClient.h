@@ -0,0 +1,307 @@
+#pragma once
+
+// Firmware only: needs the Arduino WiFiClient. Not part of the host build.
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "HttpResponse.h"
+
+// HTTP/1.1 GET over one long-lived TCP connection. HTTPClient opens and
+// closes a socket for every poll, so each one pays a TCP handshake and the
+// FIN exchange on air. StatusClient keeps the socket open between polls and
+// only reconnects when the server closed it or a request failed. A request
+// on a reused socket that gets no response at all (the server timed the
+// idle connection out just before) is retried once on a fresh connection.
+// Responses are read without waiting (start(), then service() until done),
+// so a long poll held by the server does not stall the caller. Every
+// request is timed in three phases: connect, request sent to first
+// response byte, and first byte to end of body; bytes sent and received
+// (headers included) are counted.
+
+namespace TankControl {
+
+struct HttpPhaseStats {
+  uint32_t lastUs = 0;
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+  uint32_t count = 0;
+
+  void record(uint32_t us) {
+    lastUs = us;
+    if (us > maxUs) {
+      maxUs = us;
+    }
+    totalUs += us;
+    ++count;
+  }
+
+  uint32_t meanUs() const {
+    return count ? static_cast<uint32_t>(totalUs / count) : 0;
+  }
+};
+
+class StatusClient {
+ public:
+  // service() result while the response is still on its way; complete
+  // results are the HTTP status or one of the negative kError codes.
+  static constexpr int kPending = 0;
+  static constexpr int kErrorUrl = -1;
+  static constexpr int kErrorConnect = -2;
+  static constexpr int kErrorSend = -3;
+  static constexpr int kErrorTimeout = -4;
+  static constexpr int kErrorProtocol = -5;
+  static constexpr int kErrorTooLarge = -6;
+
+  static constexpr size_t kMaxQueryLength = 47;
+
+  // Takes "http://host[:port]/path". Returns false for anything else,
+  // including https.
+  bool begin(const char *url, uint32_t timeoutMs = 2000) {
+    timeoutMs_ = timeoutMs;
+    valid_ = url_.parse(url);
+    return valid_;
+  }
+
+  // Drops the connection and any request in flight, e.g. after WiFi loss;
+  // the next request reconnects.
+  void stop() {
+    client_.stop();
+    busy_ = false;
+  }
+
+  bool busy() const { return busy_; }
+
+  // Sends a GET of the URL, with "?query" when query is not empty. holdMs
+  // is how long the server may hold the request (long poll); it is added
+  // to the timeout. Connecting blocks for up to the timeout; nothing else
+  // does. Returns kPending, or a kError code if the request could not be
+  // sent.
+  int start(const char *query = nullptr, uint32_t holdMs = 0) {
+    if (!valid_) {
+      return kErrorUrl;
+    }
+    ++requests_;
+    size_t length = 0;
+    for (; query != nullptr && query[length] != '\0' &&
+           length < kMaxQueryLength;
+         ++length) {
+      query_[length] = query[length];
+    }
+    query_[length] = '\0';
+    holdMs_ = holdMs;
+    retried_ = false;
+    return settle(send());
+  }
+
+  // Reads whatever has arrived without waiting. Returns kPending until the
+  // response is complete, then its HTTP status or a kError code. The body
+  // goes straight from the socket into the caller's buffer, NUL-terminated,
+  // with no heap use; a body that does not fit capacity - 1 bytes fails
+  // with kErrorTooLarge. length is valid when the status is positive.
+  int service(char *body, size_t capacity, size_t &length) {
+    if (!busy_) {
+      return kErrorProtocol;
+    }
+    return settle(receive(body, capacity, length));
+  }
+
+  // Blocking form of start() and service().
+  int get(char *body, size_t capacity, size_t &length,
+          const char *query = nullptr, uint32_t holdMs = 0) {
+    int result = start(query, holdMs);
+    while (result == kPending) {
+      result = service(body, capacity, length);
+      if (result == kPending) {
+        delay(1);
+      }
+    }
+    return result;
+  }
+
+  uint16_t port() const { return url_.port; }
+  const char *host() const { return url_.host; }
+  uint32_t requests() const { return requests_; }
+  uint32_t connects() const { return connects_; }
+  uint32_t reused() const { return reused_; }
+  uint32_t staleRetries() const { return staleRetries_; }
+  uint32_t failures() const { return failures_; }
+  uint32_t serverCloses() const { return serverCloses_; }
+  bool lastReused() const { return lastReused_; }
+  uint32_t lastHeldMs() const { return lastHeldMs_; }
+  // Request and response bytes on the socket, headers included.
+  uint32_t bytesSent() const { return bytesSent_; }
+  uint32_t bytesReceived() const { return bytesReceived_; }
+  uint32_t lastResponseBytes() const { return lastResponseBytes_; }
+  const HttpPhaseStats &connectStats() const { return connectStats_; }
+  // Request sent to first byte, less any time the server reported holding
+  // a long poll: server work plus one round trip.
+  const HttpPhaseStats &firstByteStats() const { return firstByteStats_; }
+  const HttpPhaseStats &bodyStats() const { return bodyStats_; }
+  const HttpPhaseStats &totalStats() const { return totalStats_; }
+
+ private:
+  static constexpr int kRetryStale = -100;
+  static constexpr size_t kReadChunk = 256;
+
+  // A reused socket that turns out to be dead gets the request once more
+  // on a fresh connection.
+  int settle(int result) {
+    if (result == kRetryStale && !retried_) {
+      retried_ = true;
+      ++staleRetries_;
+      client_.stop();
+      result = send();
+    }
+    if (result == kRetryStale) {
+      result = kErrorProtocol;
+    }
+    if (result != kPending) {
+      busy_ = false;
+      if (result < 0) {
+        ++failures_;
+        client_.stop();
+      }
+    }
+    return result;
+  }
+
+  int send() {
+    startUs_ = micros();
+    lastReused_ = client_.connected();
+    if (!lastReused_) {
+      client_.stop();
+      if (!client_.connect(url_.host, url_.port,
+                           static_cast<int32_t>(timeoutMs_))) {
+        return kErrorConnect;
+      }
+      // Requests are one small write; do not let Nagle hold them back.
+      client_.setNoDelay(true);
+      ++connects_;
+    }
+    connectedUs_ = micros();
+
+    char head[HttpUrl::kMaxHostLength + HttpUrl::kMaxPathLength +
+              kMaxQueryLength + 64];
+    size_t headLength = url_.formatGet(
+        head, sizeof(head), "Connection: keep-alive\r\n", query_);
+    if (headLength == 0) {
+      return kErrorUrl;
+    }
+    if (client_.write(reinterpret_cast<const uint8_t *>(head), headLength) !=
+        headLength) {
+      return lastReused_ ? kRetryStale : kErrorSend;
+    }
+    bytesSent_ += headLength;
+    lastResponseBytes_ = 0;
+    deadlineMs_ = millis() + timeoutMs_ + holdMs_;
+    parser_.reset();
+    firstByte_ = false;
+    busy_ = true;
+    return kPending;
+  }
+
+  int receive(char *body, size_t capacity, size_t &length) {
+    int available = client_.available();
+    if (available <= 0) {
+      if (!client_.connected()) {
+        if (!firstByte_) {
+          return lastReused_ ? kRetryStale : kErrorProtocol;
+        }
+        parser_.closed();
+        return parser_.failed() ? kErrorProtocol : finish();
+      }
+      if (static_cast<int32_t>(millis() - deadlineMs_) >= 0) {
+        return kErrorTimeout;
+      }
+      return kPending;
+    }
+    if (!firstByte_) {
+      firstByte_ = true;
+      firstByteUs_ = micros();
+      length = 0;
+    }
+
+    uint8_t buffer[kReadChunk];
+    while (available > 0 && !parser_.done()) {
+      size_t want = static_cast<size_t>(available) < sizeof(buffer)
+                        ? static_cast<size_t>(available)
+                        : sizeof(buffer);
+      int got = client_.read(buffer, want);
+      if (got <= 0) {
+        break;
+      }
+      bytesReceived_ += static_cast<uint32_t>(got);
+      lastResponseBytes_ += static_cast<uint32_t>(got);
+      for (int i = 0; i < got && !parser_.done(); ++i) {
+        if (parser_.feed(buffer[i])) {
+          if (length + 1 >= capacity) {
+            return kErrorTooLarge;
+          }
+          body[length++] = static_cast<char>(buffer[i]);
+        }
+        if (parser_.failed()) {
+          return kErrorProtocol;
+        }
+      }
+      available = client_.available();
+    }
+    if (capacity > 0) {
+      body[length] = '\0';
+    }
+    return parser_.done() ? finish() : kPending;
+  }
+
+  int finish() {
+    uint32_t doneUs = micros();
+    if (lastReused_) {
+      ++reused_;
+    }
+    if (!parser_.keepAlive()) {
+      ++serverCloses_;
+      client_.stop();
+    }
+    if (!lastReused_) {
+      connectStats_.record(connectedUs_ - startUs_);
+    }
+    lastHeldMs_ = parser_.heldMs();
+    uint32_t waitedUs = firstByteUs_ - connectedUs_;
+    uint32_t heldUs = lastHeldMs_ * 1000;
+    firstByteStats_.record(waitedUs > heldUs ? waitedUs - heldUs : 0);
+    bodyStats_.record(doneUs - firstByteUs_);
+    totalStats_.record(doneUs - startUs_);
+    return parser_.status();
+  }
+
+  WiFiClient client_;
+  HttpResponseParser parser_;
+  HttpUrl url_;
+  char query_[kMaxQueryLength + 1] = {};
+  uint32_t timeoutMs_ = 2000;
+  uint32_t holdMs_ = 0;
+  bool valid_ = false;
+  bool busy_ = false;
+  bool retried_ = false;
+  bool lastReused_ = false;
+  bool firstByte_ = false;
+  uint32_t startUs_ = 0;
+  uint32_t connectedUs_ = 0;
+  uint32_t firstByteUs_ = 0;
+  uint32_t deadlineMs_ = 0;
+  uint32_t lastHeldMs_ = 0;
+  uint32_t requests_ = 0;
+  uint32_t connects_ = 0;
+  uint32_t reused_ = 0;
+  uint32_t staleRetries_ = 0;
+  uint32_t failures_ = 0;
+  uint32_t serverCloses_ = 0;
+  uint32_t bytesSent_ = 0;
+  uint32_t bytesReceived_ = 0;
+  uint32_t lastResponseBytes_ = 0;
+  HttpPhaseStats connectStats_;
+  HttpPhaseStats firstByteStats_;
+  HttpPhaseStats bodyStats_;
+  HttpPhaseStats totalStats_;
+};
+
+}  // namespace TankControl
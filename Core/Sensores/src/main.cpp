@@ -7,6 +7,8 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include "LoRaBoards.h"
+#include "../common/RadioAccess.h"
+#include "../common/ListenBeforeTalk.h"
 
 // --- Configuración LoRa (opcional) ---
 #ifndef CONFIG_RADIO_FREQ
@@ -18,6 +20,9 @@
 #ifndef CONFIG_RADIO_BW
 #define CONFIG_RADIO_BW 125.0
 #endif
+#ifndef CONFIG_RADIO_SPI_HZ
+#define CONFIG_RADIO_SPI_HZ 10000000
+#endif
 
 // --- Pines ---
 static const int MY_I2C_SDA = 21;
@@ -32,6 +37,13 @@ const char *password = "";
 // --- Servidor ---
 const char *serverUrl = "http://3.230.70.191:4040/data";
 
+// --- Radio: paquete completo al FIFO en una sola transacción SPI ---
+TankControl::RadioAccess radioAccess;
+// Perfil del nodo (SF10, CR 4/7, preámbulo 16, sin CRC) para tiempo en aire y CAD
+const TankControl::RadioProfile kRadioProfile = {10, static_cast<uint32_t>(CONFIG_RADIO_BW * 1000), 7, 16, false, false};
+// Escucha antes de transmitir: CAD y espera aleatoria mientras el canal esté ocupado
+TankControl::ListenBeforeTalk lbt;
+
 // --- Sensores ---
 ClosedCube_HDC1080 hdc1080;
 TinyGPSPlus gps;
@@ -61,6 +73,25 @@ void smartDelay(unsigned long ms)
   } while (millis() - start < ms);
 }
 
+// Bloquea hasta que el CAD no detecta actividad o se agotan los intentos;
+// durante la espera sigue leyendo el GPS
+void waitForClearChannel(size_t length)
+{
+  uint32_t cadUs = TankControl::cadTimeUs(kRadioProfile);
+  uint32_t airUs = TankControl::timeOnAirUs(kRadioProfile, length);
+  lbt.start(micros());
+  for (;;)
+  {
+    LoRa.idle();
+    bool busy = !radioAccess.channelClear(4 * cadUs + 1000);
+    uint32_t backoffUs = lbt.next(busy, cadUs, airUs, esp_random());
+    if (backoffUs == 0)
+      break;
+    smartDelay(backoffUs / 1000 + 1);
+  }
+  lbt.transmitted(micros());
+}
+
 bool connectWiFi()
 {
   WiFi.mode(WIFI_STA);
@@ -155,6 +186,8 @@ void setup()
 #endif
 
   LoRa.setPins(RADIO_CS_PIN, RADIO_RST_PIN, RADIO_DIO0_PIN);
+  LoRa.setSPIFrequency(CONFIG_RADIO_SPI_HZ);
+  radioAccess.begin(SPI, RADIO_CS_PIN, CONFIG_RADIO_SPI_HZ);
   if (!LoRa.begin(CONFIG_RADIO_FREQ * 1000000))
   {
     Serial.println("LoRa no iniciado (opcional)");
@@ -163,12 +196,12 @@ void setup()
   {
     LoRa.setTxPower(CONFIG_RADIO_OUTPUT_POWER);
     LoRa.setSignalBandwidth(CONFIG_RADIO_BW * 1000);
-    LoRa.setSpreadingFactor(10);
-    LoRa.setPreambleLength(16);
+    LoRa.setSpreadingFactor(kRadioProfile.spreadingFactor);
+    LoRa.setPreambleLength(kRadioProfile.preambleSymbols);
     LoRa.setSyncWord(0xAB);
     LoRa.disableCrc();
     LoRa.disableInvertIQ();
-    LoRa.setCodingRate4(7);
+    LoRa.setCodingRate4(kRadioProfile.codingRate);
     Serial.println("LoRa iniciado (opcional)");
   }
 
@@ -226,10 +259,14 @@ void loop()
                      "\nTemp: " + String(avgTemp, 1) + "C" +
                      "\nHum: " + String(avgHum, 1) + "%";
 
+    waitForClearChannel(mensaje.length());
     LoRa.beginPacket();
-    LoRa.print(mensaje);
+    radioAccess.loadPacket(reinterpret_cast<const uint8_t *>(mensaje.c_str()), mensaje.length());
     LoRa.endPacket();
     Serial.println("Enviado por LoRa (opcional)");
+    Serial.printf("LBT: espera %u us, canal ocupado %u de %u veces, forzados %u\n",
+                  static_cast<unsigned>(lbt.lastDelayUs()), static_cast<unsigned>(lbt.busy()),
+                  static_cast<unsigned>(lbt.checks()), static_cast<unsigned>(lbt.forced()));
     Serial.println(mensaje);
     Serial.println();
   }
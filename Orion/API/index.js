@@ -4,28 +4,222 @@ const cors = require('cors');
 const app = express();
 const port = process.env.PORT || '4040';
 const key = 'AK90YTFGHJ007WQ';
-var instruction = "STOP";
-var speed = 0;
+const maxSegments = 8;
+// Estado de mando por vehículo (1..maxVehicles); el vehículo 1 también se
+// publica en los campos de primer nivel para controladores de un solo vehículo
+const maxVehicles = 32;
+var vehicles = new Map();
 var latitud = 6;
 var longitud = -75;
 var temperatura = 20;
 var humedad = 50;
+// Versión del estado de mando: sube con cada POST /status
+var statusVersion = 0;
+var statusChangedAt = Date.now();
+// Canal push (Server-Sent Events) hacia los controladores conectados a /events
+const pushPingMs = 500;
+var pushClients = new Set();
+// Long-poll de GET /status?since=N&wait=ms: peticiones en espera de un cambio
+const maxLongPollMs = 25000;
+var statusWaiters = new Set();
+// Los ids de trayectoria parten de una base distinta en cada arranque: el
+// controlador envía cada id una sola vez y no sabe que el servidor reinició
+const trajectoryIdBase = Date.now() >>> 0;
+
+function vehicleState(id) {
+  if (!vehicles.has(id)) {
+    vehicles.set(id, { instruction: 'STOP', speed: 0, leftDrive: 0, rightDrive: 0, segments: [], trajectoryId: trajectoryIdBase });
+  }
+  return vehicles.get(id);
+}
+
+function commandBody(state) {
+  const body = { command: state.instruction, speedness: state.speed };
+  if (String(state.instruction).toUpperCase() === 'DRIVE') {
+    body.left = state.leftDrive;
+    body.right = state.rightDrive;
+  }
+  if (state.segments.length > 0) {
+    body.segments = state.segments;
+    body.trajectoryId = state.trajectoryId;
+  }
+  return body;
+}
+
+function statusBody() {
+  const body = commandBody(vehicleState(1));
+  body.vehicles = [...vehicles.keys()].sort((a, b) => a - b).map((id) => ({ id: id, ...commandBody(vehicles.get(id)) }));
+  body.version = statusVersion;
+  return body;
+}
+
+// clickToServerMs: estimación del frontend con su propio reloj (mitad de su
+// último POST); no mezcla los relojes del navegador y del servidor
+function statusEvent(clickToServerMs) {
+  const body = statusBody();
+  if (clickToServerMs !== undefined) {
+    body.clickToServerMs = clickToServerMs;
+  }
+  return `id: ${statusVersion}\nevent: status\ndata: ${JSON.stringify(body)}\n\n`;
+}
+
+function sendStatus(res, heldMs) {
+  res.set('X-Status-Version', String(statusVersion));
+  res.set('X-Held-Ms', String(heldMs));
+  res.status(200).send(statusBody());
+}
+
+// Representación binaria de GET /status para controladores con pocos
+// recursos (Core/Controles/common/StatusBinary.h), little-endian:
+// cabecera   formato u8, vehículos u8, versión u32, antigüedad ms u32
+// vehículo   id u8, comando u8, velocidad u8, izquierda i8, derecha i8,
+//            segmentos u8, id de trayectoria u32, y después sus segmentos
+// segmento   comando u8, velocidad u8, duración ms u16
+const statusBinaryFormat = 1;
+// Valores de TankControl::Command; un nombre desconocido se envía como STOP
+const commandCodes = { STOP: 0, FORWARD: 1, BACKWARD: 2, LEFT: 3, RIGHT: 4, TRAJECTORY: 6, DRIVE: 7 };
+
+function commandCode(name) {
+  return commandCodes[String(name).toUpperCase()] || 0;
+}
+
+function clampInt(value, min, max) {
+  const number = Math.trunc(Number(value));
+  return Number.isFinite(number) ? Math.max(min, Math.min(max, number)) : 0;
+}
+
+function statusBinary() {
+  const ids = [...vehicles.keys()].sort((a, b) => a - b);
+  let size = 10;
+  for (const id of ids) {
+    size += 10 + 4 * vehicles.get(id).segments.length;
+  }
+  const body = Buffer.alloc(size);
+  let at = body.writeUInt8(statusBinaryFormat, 0);
+  at = body.writeUInt8(ids.length, at);
+  at = body.writeUInt32LE(statusVersion >>> 0, at);
+  at = body.writeUInt32LE(Math.min(Date.now() - statusChangedAt, 0xffffffff), at);
+  for (const id of ids) {
+    const state = vehicles.get(id);
+    const drive = String(state.instruction).toUpperCase() === 'DRIVE';
+    at = body.writeUInt8(id, at);
+    at = body.writeUInt8(commandCode(state.instruction), at);
+    at = body.writeUInt8(clampInt(state.speed, 0, 100), at);
+    at = body.writeInt8(drive ? clampInt(state.leftDrive, -100, 100) : 0, at);
+    at = body.writeInt8(drive ? clampInt(state.rightDrive, -100, 100) : 0, at);
+    at = body.writeUInt8(state.segments.length, at);
+    at = body.writeUInt32LE(state.segments.length > 0 ? state.trajectoryId >>> 0 : 0, at);
+    for (const segment of state.segments) {
+      at = body.writeUInt8(commandCode(segment.command), at);
+      at = body.writeUInt8(clampInt(segment.speedness, 0, 100), at);
+      at = body.writeUInt16LE(clampInt(segment.ms, 0, 65535), at);
+    }
+  }
+  return body;
+}
+
+function sendStatusBinary(res, heldMs) {
+  res.set('X-Status-Version', String(statusVersion));
+  res.set('X-Held-Ms', String(heldMs));
+  res.set('Content-Type', 'application/octet-stream');
+  // end() en lugar de send(): sin ETag
+  res.status(200).end(statusBinary());
+}
+
+function pushStatus(clickToServerMs) {
+  const event = statusEvent(clickToServerMs);
+  for (const res of pushClients) {
+    res.write(event);
+  }
+  for (const waiter of statusWaiters) {
+    waiter.release();
+  }
+}
+
+vehicleState(1);
+
+// El ping mantiene vivo el canal y le sirve al controlador como prueba de
+// que el servidor sigue accesible
+setInterval(() => {
+  for (const res of pushClients) {
+    res.write(': ping\n\n');
+  }
+}, pushPingMs);
 
 app.use(cors());
 app.use(express.json());
 app.use(express.urlencoded({ extended: true }));
 
-app.listen(port, () => {
+const server = app.listen(port, () => {
   console.log(`Orion API corriendo en http://localhost:${port}`);
 });
+// El controlador mantiene una sola conexión abierta y consulta cada 500 ms
+// (2 s con el canal push activo); el cierre por inactividad debe quedar bien
+// por encima de eso.
+server.keepAliveTimeout = 30000;
+server.headersTimeout = 31000;
 
 app.get('/', (req, res) => {
   res.send('Orion API etá corriendo.');
 });
 
 // Endpoint para recibir y actualizar instrucciones
-app.get('/status', (req, res) => {
-  res.status(200).send({ command: instruction, speedness: speed });
+// Sin since responde de inmediato. Con since=N responde en cuanto la versión
+// sea distinta de N (también si es menor: el servidor se reinició) o, pasado
+// wait ms sin cambios, con 304 y sin cuerpo.
+function statusRoute(send, compact) {
+  return (req, res) => {
+    if (compact) {
+      // Cada byte de cabecera viaja en cada consulta del controlador
+      res.removeHeader('X-Powered-By');
+      res.sendDate = false;
+    }
+    const since = Number(req.query.since);
+    if (req.query.since === undefined || !Number.isInteger(since) || since !== statusVersion) {
+      return send(res, 0);
+    }
+    const wait = Math.max(0, Math.min(maxLongPollMs, Number(req.query.wait) || 0));
+    const heldFrom = Date.now();
+    const waiter = {
+      release: () => {
+        clearTimeout(waiter.timer);
+        statusWaiters.delete(waiter);
+        send(res, Date.now() - heldFrom);
+      },
+      timer: setTimeout(() => {
+        statusWaiters.delete(waiter);
+        res.set('X-Status-Version', String(statusVersion));
+        res.set('X-Held-Ms', String(Date.now() - heldFrom));
+        res.status(304).end();
+      }, wait),
+    };
+    statusWaiters.add(waiter);
+    req.on('close', () => {
+      clearTimeout(waiter.timer);
+      statusWaiters.delete(waiter);
+    });
+  };
+}
+
+app.get('/status', statusRoute(sendStatus, false));
+// Misma semántica (since/wait, 304) en formato binario y con cabeceras mínimas
+app.get('/status.bin', statusRoute(sendStatusBinary, true));
+
+// Canal push: envía el estado completo al conectar y después en cada POST /status
+app.get('/events', (req, res) => {
+  res.writeHead(200, {
+    'Content-Type': 'text/event-stream',
+    'Cache-Control': 'no-cache',
+    Connection: 'keep-alive',
+  });
+  req.socket.setNoDelay(true);
+  res.write(statusEvent());
+  pushClients.add(res);
+  console.log(`Canal push abierto (${pushClients.size} conectados)`);
+  req.on('close', () => {
+    pushClients.delete(res);
+    console.log(`Canal push cerrado (${pushClients.size} conectados)`);
+  });
 });
 
 app.post('/status', (req, res) => {
@@ -37,10 +231,41 @@ app.post('/status', (req, res) => {
     return res.status(403).send('Clave API inválida.');
   }
   const { cmd, speedness } = req.body;
-  instruction = cmd;
-  speed = speedness;
-  console.log(`Instrucción actualizada: ${instruction}`);
-  console.log(`Velocidad actualizada: ${speed}%`);
+  // Vehículo destino opcional (1 por defecto)
+  const vehicle = req.body.vehicle === undefined ? 1 : Number(req.body.vehicle);
+  if (!Number.isInteger(vehicle) || vehicle < 1 || vehicle > maxVehicles) {
+    return res.status(400).send(`Vehículo inválido (1 a ${maxVehicles}).`);
+  }
+  const state = vehicleState(vehicle);
+  // Trayectoria opcional: [{ command, speedness, ms }, ...] enviada en un solo paquete LoRa
+  if (Array.isArray(req.body.segments) && req.body.segments.length > 0) {
+    if (req.body.segments.length > maxSegments) {
+      return res.status(400).send(`Máximo ${maxSegments} segmentos por trayectoria.`);
+    }
+    state.segments = req.body.segments.map(({ command, speedness, ms }) => ({
+      command: command,
+      speedness: Number(speedness) || 0,
+      ms: Number(ms) || 0,
+    }));
+    state.trajectoryId = (state.trajectoryId + 1) >>> 0;
+    state.instruction = 'TRAJECTORY';
+  } else {
+    state.segments = [];
+    state.instruction = cmd;
+  }
+  // Velocidades por rueda (-100 a 100) para el comando DRIVE
+  if (String(cmd).toUpperCase() === 'DRIVE') {
+    state.leftDrive = Math.max(-100, Math.min(100, Number(req.body.left) || 0));
+    state.rightDrive = Math.max(-100, Math.min(100, Number(req.body.right) || 0));
+  }
+  state.speed = speedness;
+  statusVersion++;
+  statusChangedAt = Date.now();
+  const uplinkMs = Number(req.body.uplinkMs);
+  const clickToServerMs = Number.isFinite(uplinkMs) && uplinkMs >= 0 ? Math.round(uplinkMs) : undefined;
+  pushStatus(clickToServerMs);
+  console.log(`Vehículo ${vehicle} - Instrucción actualizada: ${state.instruction}`);
+  console.log(`Vehículo ${vehicle} - Velocidad actualizada: ${state.speed}%`);
   res.status(200).send('Instrucción y velocidad actualizadas.');
 });
 
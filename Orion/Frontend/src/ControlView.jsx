@@ -1,13 +1,19 @@
-import { useState } from "react";
+import { useRef, useState } from "react";
 import "./App.css";
 
 export default function ControlView() {
   const [speed, setSpeed] = useState(50);
   const [error, setError] = useState(null);
+  // Mitad del último POST medida solo con el reloj del navegador; viaja en el
+  // siguiente POST como estimación de clic a servidor
+  const uplinkMs = useRef(null);
 
   const api = "http://3.230.70.191:4040/status";
 
   const handleControl = async (command) => {
+    const startedAt = performance.now();
+    const body = { cmd: command, speedness: speed };
+    if (uplinkMs.current !== null) body.uplinkMs = uplinkMs.current;
     try {
       const response = await fetch(api, {
         method: "POST",
@@ -15,10 +21,11 @@ export default function ControlView() {
           "Content-Type": "application/json",
           "x-api-key": "AK90YTFGHJ007WQ",
         },
-        body: JSON.stringify({ cmd: command, speedness: speed }),
+        body: JSON.stringify(body),
       });
 
       if (!response.ok) throw new Error("Error HTTP");
+      uplinkMs.current = Math.round((performance.now() - startedAt) / 2);
       setError(null);
     } catch (err) {
       setError("Error al enviar datos");